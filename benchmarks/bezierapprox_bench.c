@@ -0,0 +1,417 @@
+#include <bezierapprox.h>
+#include <bezierapproxinline.h>
+#if BEZIERAPPROXLIB_CACHE
+#include <bezierapproxcache.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define POINTS_SIZE 100000
+#define REPEATS 5
+#define EVALUATIONS 20000000
+#define WINDOW_SIZE 16
+#define FRAMES 8
+
+#if BEZIERAPPROXLIB_STATIC
+#define LINKAGE "static"
+#else
+#define LINKAGE "shared"
+#endif
+
+// Without the BEZIERAPPROXLIB_FIT_STATS option the fit counts print as 0.
+#if !BEZIERAPPROXLIB_FIT_STATS
+typedef struct _BezierApproxFitStats {
+    unsigned long long fitsCount;
+    unsigned long long fittedPointsCount;
+} BezierApproxFitStats;
+
+static inline void bezierApproxGetFitStats(BezierApproxFitStats* stats) {
+    stats->fitsCount = 0;
+    stats->fittedPointsCount = 0;
+}
+#endif
+
+static inline double getTimeSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
+
+static inline void fillNoisyPoints(
+    BezierApproxPoint* points,
+    int pointsSize,
+    double noise
+) {
+    srand(1212);
+    for (int i = 0; i < pointsSize; ++i) {
+        double dx = noise * (2.0 * rand() / RAND_MAX - 1.0);
+        double dy = noise * (2.0 * rand() / RAND_MAX - 1.0);
+        points[i].x = 0.5 * i + dx;
+        points[i].y = 50.0 * sin(0.002 * i) + 20.0 * sin(0.013 * i) + dy;
+    }
+}
+
+static void benchTangents(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    const char* name,
+    int tangentEstimator,
+    int tangentWindow
+) {
+    int controlsBufferSize = 0;
+    int result = BEZIER_APPROX_OK;
+    BezierApproxFitStats startStats;
+    BezierApproxFitStats stats;
+    bezierApproxGetFitStats(&startStats);
+    double startTime = getTimeSeconds();
+    for (int r = 0; r < REPEATS; ++r) {
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxWithTangents(
+            points,
+            pointsSize,
+            precision,
+            tangentEstimator,
+            tangentWindow,
+            controlsBuffer,
+            &controlsBufferSize
+        );
+    }
+    double elapsed = (getTimeSeconds() - startTime) / REPEATS;
+    bezierApproxGetFitStats(&stats);
+    printf("%-16s window %d: result %d, fits %6llu, curves %6d, %8.3lf ms\n",
+        name, tangentWindow, result, (stats.fitsCount - startStats.fitsCount) / REPEATS,
+        controlsBufferSize, 1.0e3 * elapsed);
+}
+
+static void benchOrthogonal(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int refineIterations
+) {
+    int controlsBufferSize = 0;
+    int result = BEZIER_APPROX_OK;
+    double startTime = getTimeSeconds();
+    for (int r = 0; r < REPEATS; ++r) {
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxOrthogonal(
+            points,
+            pointsSize,
+            precision,
+            refineIterations,
+            controlsBuffer,
+            &controlsBufferSize
+        );
+    }
+    double elapsed = (getTimeSeconds() - startTime) / REPEATS;
+    printf("orthogonal       refine %d: result %d, curves %6d, %8.3lf ms\n",
+        refineIterations, result, controlsBufferSize, 1.0e3 * elapsed);
+}
+
+static inline double getControlsSum(const BezierApproxCurve3Controls* controls) {
+    return controls->P0.x + controls->P0.y + controls->P1.x + controls->P1.y +
+        controls->P2.x + controls->P2.y + controls->P3.x + controls->P3.y;
+}
+
+// Compares calls into the library with the header only versions, which the
+// compiler can inline and vectorize.
+static void benchCallOverhead(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    BezierApproxPoint* values
+) {
+    const BezierApproxCurve3Controls controls = {
+        { 0.0, 0.0 }, { 10.0, 30.0 }, { 40.0, -20.0 }, { 50.0, 10.0 }
+    };
+    const double step = 1.0 / pointsSize;
+    const int repeats = EVALUATIONS / pointsSize;
+
+    memset(values, 0, pointsSize * sizeof(BezierApproxPoint));
+    double startTime = getTimeSeconds();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < pointsSize; ++i) {
+            BezierApproxPoint value = bezierApproxGetCurveValue(controls, i * step);
+            values[i].x += value.x;
+            values[i].y += value.y;
+        }
+    }
+    double callTime = getTimeSeconds() - startTime;
+    double callSum = values[pointsSize / 2].x + values[pointsSize - 1].y;
+
+    memset(values, 0, pointsSize * sizeof(BezierApproxPoint));
+    startTime = getTimeSeconds();
+    for (int r = 0; r < repeats; ++r) {
+        for (int i = 0; i < pointsSize; ++i) {
+            BezierApproxPoint value = bezierApproxInlineGetCurveValue(controls, i * step);
+            values[i].x += value.x;
+            values[i].y += value.y;
+        }
+    }
+    double inlineTime = getTimeSeconds() - startTime;
+    double inlineSum = values[pointsSize / 2].x + values[pointsSize - 1].y;
+
+    printf("evaluation %s: %d values, call %8.3lf ms, inline %8.3lf ms (%.2lfx), checksums %.3lf %.3lf\n",
+        LINKAGE, repeats * pointsSize, 1.0e3 * callTime, 1.0e3 * inlineTime, callTime / inlineTime,
+        callSum, inlineSum);
+
+    const int windowsCount = pointsSize - WINDOW_SIZE;
+    BezierApproxCurve3Controls curve;
+    int failedCount = 0;
+    callSum = 0.0;
+    inlineSum = 0.0;
+
+    startTime = getTimeSeconds();
+    for (int i = 0; i < windowsCount; ++i) {
+        if (bezierApproxByOneCurve(points, i, i + WINDOW_SIZE - 1, &curve) != BEZIER_APPROX_OK) {
+            ++failedCount;
+            continue;
+        }
+        callSum += getControlsSum(&curve);
+    }
+    callTime = getTimeSeconds() - startTime;
+
+    startTime = getTimeSeconds();
+    for (int i = 0; i < windowsCount; ++i) {
+        if (bezierApproxInlineByOneCurve(points, i, i + WINDOW_SIZE - 1, &curve) != BEZIER_APPROX_OK) {
+            ++failedCount;
+            continue;
+        }
+        inlineSum += getControlsSum(&curve);
+    }
+    inlineTime = getTimeSeconds() - startTime;
+
+    printf("one curve  %s: %d windows, call %8.3lf ms, inline %8.3lf ms (%.2lfx), checksums %.3lf %.3lf, failed %d\n",
+        LINKAGE, windowsCount, 1.0e3 * callTime, 1.0e3 * inlineTime, callTime / inlineTime,
+        callSum / windowsCount, inlineSum / windowsCount, failedCount);
+}
+
+// Same samples as points, once through the generic fit and once through the
+// time series one.
+static void benchTimeSeries(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer
+) {
+    double* timestamps = (double*)malloc(pointsSize * sizeof(double));
+    double* values = (double*)malloc(pointsSize * sizeof(double));
+    if (!timestamps || !values) {
+        free(timestamps);
+        free(values);
+        return;
+    }
+    for (int i = 0; i < pointsSize; ++i) {
+        timestamps[i] = 0.5 * i;
+        values[i] = points[i].y;
+    }
+
+    int controlsBufferSize = 0;
+    int genericResult = BEZIER_APPROX_OK;
+    int genericSize = 0;
+    double startTime = getTimeSeconds();
+    for (int r = 0; r < REPEATS; ++r) {
+        controlsBufferSize = pointsSize - 1;
+        genericResult = bezierApprox(points, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+        genericSize = controlsBufferSize;
+    }
+    double genericTime = (getTimeSeconds() - startTime) / REPEATS;
+
+    int result = BEZIER_APPROX_OK;
+    startTime = getTimeSeconds();
+    for (int r = 0; r < REPEATS; ++r) {
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxTimeSeries(timestamps, values, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    }
+    double timeSeriesTime = (getTimeSeconds() - startTime) / REPEATS;
+
+    printf("time series: generic result %d, curves %6d, %8.3lf ms; "
+        "time series result %d, curves %6d, %8.3lf ms (%.2lfx)\n",
+        genericResult, genericSize, 1.0e3 * genericTime,
+        result, controlsBufferSize, 1.0e3 * timeSeriesTime, genericTime / timeSeriesTime);
+
+    free(timestamps);
+    free(values);
+}
+
+// Frames of a slowly moving stroke, each fitted from scratch and seeded with
+// the splits of the previous frame.
+static void benchWarmStart(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer
+) {
+    BezierApproxPoint* framePoints = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    double* fractions = (double*)malloc(pointsSize * sizeof(double));
+    double* nextFractions = (double*)malloc(pointsSize * sizeof(double));
+    if (!framePoints || !fractions || !nextFractions) {
+        free(framePoints);
+        free(fractions);
+        free(nextFractions);
+        return;
+    }
+
+    int fractionsSize = 0;
+    int coldCurves = 0;
+    int warmCurves = 0;
+    double coldTime = 0.0;
+    double warmTime = 0.0;
+    BezierApproxFitStats stats;
+    BezierApproxFitStats coldStats = { 0, 0 };
+    BezierApproxFitStats warmStats = { 0, 0 };
+    for (int frame = 0; frame <= FRAMES; ++frame) {
+        for (int i = 0; i < pointsSize; ++i) {
+            framePoints[i].x = points[i].x;
+            framePoints[i].y = points[i].y + 2.0 * sin(0.0005 * i + 0.05 * frame);
+        }
+
+        int controlsBufferSize = pointsSize - 1;
+        bezierApproxGetFitStats(&stats);
+        double startTime = getTimeSeconds();
+        bezierApprox(framePoints, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+        double coldFrameTime = getTimeSeconds() - startTime;
+        BezierApproxFitStats coldFrameStats;
+        bezierApproxGetFitStats(&coldFrameStats);
+        coldFrameStats.fitsCount -= stats.fitsCount;
+        coldFrameStats.fittedPointsCount -= stats.fittedPointsCount;
+        const int coldFrameCurves = controlsBufferSize;
+
+        controlsBufferSize = pointsSize - 1;
+        bezierApproxGetFitStats(&stats);
+        startTime = getTimeSeconds();
+        bezierApproxWarmStart(framePoints, pointsSize, precision, fractions, fractionsSize,
+            controlsBuffer, &controlsBufferSize, nextFractions);
+        double warmFrameTime = getTimeSeconds() - startTime;
+        BezierApproxFitStats warmFrameStats;
+        bezierApproxGetFitStats(&warmFrameStats);
+
+        double* swap = fractions;
+        fractions = nextFractions;
+        nextFractions = swap;
+        fractionsSize = controlsBufferSize - 1;
+
+        // The first frame has no seeds and only primes the next one.
+        if (frame == 0) {
+            continue;
+        }
+        coldCurves += coldFrameCurves;
+        coldTime += coldFrameTime;
+        coldStats.fitsCount += coldFrameStats.fitsCount;
+        coldStats.fittedPointsCount += coldFrameStats.fittedPointsCount;
+        warmCurves += controlsBufferSize;
+        warmTime += warmFrameTime;
+        warmStats.fitsCount += warmFrameStats.fitsCount - stats.fitsCount;
+        warmStats.fittedPointsCount += warmFrameStats.fittedPointsCount - stats.fittedPointsCount;
+    }
+
+    printf("warm start, per frame: cold fits %6llu, fitted points %9llu, curves %6d, %8.3lf ms; "
+        "warm fits %6llu, fitted points %9llu, curves %6d, %8.3lf ms\n",
+        coldStats.fitsCount / FRAMES, coldStats.fittedPointsCount / FRAMES, coldCurves / FRAMES,
+        1.0e3 * coldTime / FRAMES,
+        warmStats.fitsCount / FRAMES, warmStats.fittedPointsCount / FRAMES, warmCurves / FRAMES,
+        1.0e3 * warmTime / FRAMES);
+
+    free(framePoints);
+    free(fractions);
+    free(nextFractions);
+}
+
+#if BEZIERAPPROXLIB_CACHE
+static void benchCache(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer
+) {
+    BezierApproxCache* cache = NULL;
+    if (bezierApproxCacheCreate((size_t)1 << 26, NULL, &cache) != BEZIER_APPROX_OK) {
+        return;
+    }
+
+    int controlsBufferSize = pointsSize - 1;
+    double startTime = getTimeSeconds();
+    int missResult = bezierApproxCacheFit(cache, points, pointsSize, precision,
+        BEZIER_APPROX_TANGENT_CENTRAL, 0, controlsBuffer, &controlsBufferSize);
+    double missTime = getTimeSeconds() - startTime;
+
+    int hitResult = BEZIER_APPROX_OK;
+    startTime = getTimeSeconds();
+    for (int r = 0; r < REPEATS; ++r) {
+        controlsBufferSize = pointsSize - 1;
+        hitResult = bezierApproxCacheFit(cache, points, pointsSize, precision,
+            BEZIER_APPROX_TANGENT_CENTRAL, 0, controlsBuffer, &controlsBufferSize);
+    }
+    double hitTime = (getTimeSeconds() - startTime) / REPEATS;
+
+    BezierApproxCacheStats stats;
+    bezierApproxCacheGetStats(cache, &stats);
+    printf("cache: miss result %d, %8.3lf ms; hit result %d, %8.3lf ms (%.0lfx); "
+        "hits %llu, misses %llu, %zu bytes\n",
+        missResult, 1.0e3 * missTime, hitResult, 1.0e3 * hitTime, missTime / hitTime,
+        stats.hits, stats.misses, stats.bytesUsed);
+    bezierApproxCacheDestroy(cache);
+}
+#endif
+
+int main() {
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    BezierApproxPoint* values = NULL;
+    int errorCode = 1;
+
+    points = (BezierApproxPoint*)malloc(POINTS_SIZE * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc((POINTS_SIZE - 1) * sizeof(BezierApproxCurve3Controls));
+    values = (BezierApproxPoint*)malloc(POINTS_SIZE * sizeof(BezierApproxPoint));
+    if (!points || !controlsBuffer || !values) {
+        goto cleanup;
+    }
+
+    const double noise = 0.2;
+    const double precision = 1.0;
+    fillNoisyPoints(points, POINTS_SIZE, noise);
+    benchCallOverhead(points, POINTS_SIZE, values);
+    printf("tangents: %d points, noise %.2lf, precision %.2lf\n", POINTS_SIZE, noise, precision);
+    benchTangents(points, POINTS_SIZE, precision, controlsBuffer,
+        "central", BEZIER_APPROX_TANGENT_CENTRAL, 1);
+    for (int window = 2; window <= 8; window *= 2) {
+        benchTangents(points, POINTS_SIZE, precision, controlsBuffer,
+            "least squares", BEZIER_APPROX_TANGENT_LEAST_SQUARES, window);
+        benchTangents(points, POINTS_SIZE, precision, controlsBuffer,
+            "arc weighted", BEZIER_APPROX_TANGENT_ARC_WEIGHTED, window);
+    }
+    for (int refineIterations = 0; refineIterations <= 4; refineIterations += 2) {
+        benchOrthogonal(points, POINTS_SIZE, precision, controlsBuffer, refineIterations);
+    }
+    benchWarmStart(points, POINTS_SIZE, precision, controlsBuffer);
+#if BEZIERAPPROXLIB_CACHE
+    benchCache(points, POINTS_SIZE, precision, controlsBuffer);
+#endif
+    for (int i = 0; i < POINTS_SIZE; ++i) {
+        points[i].x = 0.5 * i;
+    }
+    benchTimeSeries(points, POINTS_SIZE, precision, controlsBuffer);
+    errorCode = 0;
+
+cleanup:
+    if (values) {
+        free(values);
+        values = NULL;
+    }
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return errorCode;
+}
@@ -15,17 +15,36 @@
     #pragma warning Unknown dynamic link import/export semantics.
 #endif
 
-#if BEZIERAPPROXLIB_COMPILING
+#if BEZIERAPPROXLIB_STATIC
+#   define BEZIERAPPROXLIB_PUBLIC
+#elif BEZIERAPPROXLIB_COMPILING
 #   define BEZIERAPPROXLIB_PUBLIC EXPORT
 #else
 #   define BEZIERAPPROXLIB_PUBLIC IMPORT
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define BEZIER_APPROX_OK 0
 #define BEZIER_APPROX_FAILED -1
 #define BEZIER_APPROX_ARGUMENTS_ERROR -2
 #define BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR -3
 #define BEZIER_APPROX_BUFFER_TOO_SMALL -4
+#define BEZIER_APPROX_QUEUE_FULL -5
+#define BEZIER_APPROX_INTERRUPTED 1
+
+#define BEZIER_APPROX_TANGENT_CENTRAL 0
+#define BEZIER_APPROX_TANGENT_LEAST_SQUARES 1
+#define BEZIER_APPROX_TANGENT_ARC_WEIGHTED 2
+
+// Polled by bezierApproxWithBudget before every subdivision, a non-zero
+// result stops it. If the request to stop comes from another thread, the
+// callback must read it in a thread safe way, e.g. with an atomic load.
+typedef int (*BezierApproxCancelCallback)(
+    void* userData
+);
 
 BEZIERAPPROXLIB_PUBLIC
 typedef struct _BezierApproxPoint {
@@ -41,6 +60,20 @@ typedef struct _BezierApproxCurve3Controls {
     BezierApproxPoint P3;
 } BezierApproxCurve3Controls;
 
+BEZIERAPPROXLIB_PUBLIC
+typedef struct _BezierApproxPointF {
+    float x;
+    float y;
+} BezierApproxPointF;
+
+BEZIERAPPROXLIB_PUBLIC
+typedef struct _BezierApproxCurve3ControlsF {
+    BezierApproxPointF P0;
+    BezierApproxPointF P1;
+    BezierApproxPointF P2;
+    BezierApproxPointF P3;
+} BezierApproxCurve3ControlsF;
+
 BEZIERAPPROXLIB_PUBLIC
 int bezierApprox(
     const BezierApproxPoint points[],
@@ -63,3 +96,200 @@ BezierApproxPoint bezierApproxGetCurveValue(
     const BezierApproxCurve3Controls controls,
     double t
 );
+
+// Single precision variants, built from the templates in bezierapprox.hpp.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxF(
+    const BezierApproxPointF points[],
+    int pointsSize,
+    float precision,
+    BezierApproxCurve3ControlsF* controlsBuffer,
+    int* controlsBufferSize
+);
+
+BEZIERAPPROXLIB_PUBLIC
+BezierApproxPointF bezierApproxGetCurveValueF(
+    const BezierApproxCurve3ControlsF controls,
+    float t
+);
+
+// Same as bezierApprox, but also stores the point index where every curve
+// starts into splitIndicesBuffer, followed by the last point index, so the
+// buffer must hold *controlsBufferSize + 1 values. It may be NULL.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxWithSplits(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* splitIndicesBuffer
+);
+
+// Same as bezierApprox, but starts from the split positions of a previous
+// fit, given as sorted arc-length fractions in (0, 1). Seeded curves are
+// subdivided only where they miss the precision and merged where one curve
+// is enough. The new *controlsBufferSize - 1 split fractions are stored into
+// splitFractionsBuffer if it is not NULL, to seed the next call.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxWarmStart(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    const double prevSplitFractions[],
+    int prevSplitFractionsSize,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* splitFractionsBuffer
+);
+
+// Same as bezierApprox, but estimates the tangents at the ends and at the
+// splits from tangentWindow neighbours on each side instead of the two
+// nearest points: BEZIER_APPROX_TANGENT_LEAST_SQUARES fits a line through
+// them, BEZIER_APPROX_TANGENT_ARC_WEIGHTED averages the spans weighted by
+// length and by arc length distance. This helps on noisy points.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxWithTangents(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int tangentEstimator,
+    int tangentWindow,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+);
+
+// Same as bezierApprox, but a curve that misses precision at the chord length
+// parameters by a small margin gets a second chance: its parameters are
+// refined by Newton steps towards the closest points of the curve, the curve
+// is refitted with them refineIterations times, and it is kept if the
+// distance from every point to the curve at its refined parameter fits. With
+// refineIterations 0 only the measurement is refined, so fewer curves than
+// bezierApprox are possible.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxOrthogonal(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int refineIterations,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+);
+
+// Same as bezierApprox, but skips NaNs and points that repeat the previous
+// one instead of failing on them. keptIndicesBuffer must hold pointsSize
+// values and receives the indices of the points that were used, their count
+// is stored into keptIndicesSize. Neither may be NULL.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxSanitized(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* keptIndicesBuffer,
+    int* keptIndicesSize
+);
+
+// Approximates points by at most maxCurvesCount curves with the lowest max
+// distance it can reach, splitting the worst curve first. Splitting also
+// stops once every curve is within precision (pass 0 to use the whole
+// budget). For a byte budget pass bytes / sizeof(BezierApproxCurve3Controls).
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxByCurvesCount(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    int maxCurvesCount,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* maxError
+);
+
+// Updates a fit made by bezierApproxWithSplits after editRemovedCount points
+// starting from editFirstIndex were replaced by editInsertedCount new points.
+// Only the curves around the edit are refitted, the others are copied.
+// controlsBuffer and splitIndicesBuffer may be the same as the previous ones.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxRefit(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    const BezierApproxCurve3Controls prevControls[],
+    const int prevSplitIndices[],
+    int prevControlsSize,
+    int editFirstIndex,
+    int editRemovedCount,
+    int editInsertedCount,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* splitIndicesBuffer
+);
+
+// Fast path for sampled signals: timestamps must be strictly increasing.
+// The x coordinates of every curve's controls are spaced evenly, so the curve
+// passes every timestamp at a parameter known in advance, and precision
+// bounds the vertical distance. Consecutive curves share end points, but
+// unlike bezierApprox their tangents at the joins may differ.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxTimeSeries(
+    const double timestamps[],
+    const double values[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+);
+
+// Same as bezierApprox, but stops subdividing once timeBudget seconds have
+// passed (no limit if <= 0) or isCancelled returns non-zero (may be NULL).
+// Then the curves found so far are returned together with the coarser ones
+// that were not checked yet, and the result is BEZIER_APPROX_INTERRUPTED.
+// The achieved max distance is stored into maxError if it is not NULL, the
+// distances of the unchecked curves are kept from their fit, so reporting it
+// costs no extra pass. The arc lengths and the first curve are computed
+// before the budget is checked, which is one linear pass over the points
+// however small timeBudget is.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxWithBudget(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    double timeBudget,
+    BezierApproxCancelCallback isCancelled,
+    void* userData,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* maxError
+);
+
+// Only in builds with the BEZIERAPPROXLIB_FIT_STATS CMake option, which the
+// tests and the benchmark use to compare how much work the fitting options
+// take.
+#if BEZIERAPPROXLIB_FIT_STATS
+BEZIERAPPROXLIB_PUBLIC
+typedef struct _BezierApproxFitStats {
+    unsigned long long fitsCount;
+    unsigned long long fittedPointsCount;
+} BezierApproxFitStats;
+
+// Counts the one curve least squares fits made so far by the calling thread
+// and the points they went through.
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxGetFitStats(
+    BezierApproxFitStats* stats
+);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+// With BEZIERAPPROXLIB_INLINE defined, calls to the evaluation and one curve
+// fitting functions compile to their header only versions.
+#if BEZIERAPPROXLIB_INLINE && !BEZIERAPPROXLIB_COMPILING
+#include "bezierapproxinline.h"
+#define bezierApproxGetCurveValue bezierApproxInlineGetCurveValue
+#define bezierApproxGetCurveValueF bezierApproxInlineGetCurveValueF
+#define bezierApproxByOneCurve bezierApproxInlineByOneCurve
+#endif
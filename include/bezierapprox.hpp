@@ -0,0 +1,293 @@
+#pragma once
+
+#include "bezierapprox.h"
+#include "bezierapproxinline.h"
+
+#include <cmath>
+#include <vector>
+
+namespace bezierapprox {
+
+template <typename T>
+struct Traits;
+
+// The C types and kernels of bezierapproxinline.h for each precision.
+template <>
+struct Traits<double> {
+    typedef BezierApproxPoint Point;
+    typedef BezierApproxCurve3Controls Curve3Controls;
+    typedef BezierApproxInlineFitSums FitSums;
+    static constexpr double epsZero = BEZIER_APPROX_INLINE_EPS_ZERO;
+};
+
+template <>
+struct Traits<float> {
+    typedef BezierApproxPointF Point;
+    typedef BezierApproxCurve3ControlsF Curve3Controls;
+    typedef BezierApproxInlineFitSumsF FitSums;
+    static constexpr float epsZero = BEZIER_APPROX_INLINE_EPS_ZERO_F;
+};
+
+// The C structs themselves, so points and curves are passed between the C
+// interface, the templates and the C kernels without conversions.
+template <typename T>
+using Point = typename Traits<T>::Point;
+
+template <typename T>
+using Curve3Controls = typename Traits<T>::Curve3Controls;
+
+namespace detail {
+
+template <typename T>
+struct StackEntry {
+    Curve3Controls<T> controls;
+    Point<T> e1;
+    Point<T> e2;
+    int firstIdx;
+    int lastIdx;
+};
+
+// Templated on the point type, since T can't be deduced through the alias.
+template <typename P>
+inline P substruct(const P& a, const P& b) {
+    return P{ a.x - b.x, a.y - b.y };
+}
+
+template <typename P>
+inline decltype(P::x) norm(const P& a) {
+    return std::sqrt(a.x * a.x + a.y * a.y);
+}
+
+template <typename P>
+inline bool normalize(P& a) {
+    const decltype(P::x) n = norm(a);
+    if (std::fabs(n) < Traits<decltype(P::x)>::epsZero) {
+        return false;
+    }
+    a.x /= n;
+    a.y /= n;
+    return true;
+}
+
+inline BezierApproxPoint getCurveValue(const BezierApproxCurve3Controls& controls, double t) {
+    return bezierApproxInlineGetCurveValue(controls, t);
+}
+
+inline BezierApproxPointF getCurveValue(const BezierApproxCurve3ControlsF& controls, float t) {
+    return bezierApproxInlineGetCurveValueF(controls, t);
+}
+
+inline void addFitPoint(
+    BezierApproxInlineFitSums& sums,
+    const BezierApproxPoint& point,
+    double t,
+    const BezierApproxPoint& p0,
+    const BezierApproxPoint& p3,
+    const BezierApproxPoint& e1,
+    const BezierApproxPoint& e2
+) {
+    bezierApproxInlineAddFitPoint(&sums, point, t, p0, p3, e1, e2);
+}
+
+inline void addFitPoint(
+    BezierApproxInlineFitSumsF& sums,
+    const BezierApproxPointF& point,
+    float t,
+    const BezierApproxPointF& p0,
+    const BezierApproxPointF& p3,
+    const BezierApproxPointF& e1,
+    const BezierApproxPointF& e2
+) {
+    bezierApproxInlineAddFitPointF(&sums, point, t, p0, p3, e1, e2);
+}
+
+inline void solveFit(
+    const BezierApproxInlineFitSums& sums,
+    const BezierApproxPoint& p0,
+    const BezierApproxPoint& p3,
+    const BezierApproxPoint& e1,
+    const BezierApproxPoint& e2,
+    BezierApproxCurve3Controls& controls
+) {
+    bezierApproxInlineSolveFit(&sums, p0, p3, e1, e2, &controls);
+}
+
+inline void solveFit(
+    const BezierApproxInlineFitSumsF& sums,
+    const BezierApproxPointF& p0,
+    const BezierApproxPointF& p3,
+    const BezierApproxPointF& e1,
+    const BezierApproxPointF& e2,
+    BezierApproxCurve3ControlsF& controls
+) {
+    bezierApproxInlineSolveFitF(&sums, p0, p3, e1, e2, &controls);
+}
+
+template <typename T>
+inline T tValue(const T tDist[], int idx, int firstIdx, int lastIdx) {
+    return (tDist[idx] - tDist[firstIdx]) / (tDist[lastIdx] - tDist[firstIdx]);
+}
+
+} // namespace detail
+
+template <typename T>
+inline Point<T> evaluate(const Curve3Controls<T>& controls, T t) {
+    return detail::getCurveValue(controls, t);
+}
+
+template <typename T>
+inline void arcLengths(const Point<T> points[], int pointsSize, T tDist[]) {
+    tDist[0] = T(0);
+    for (int i = 1; i < pointsSize; ++i) {
+        tDist[i] = tDist[i - 1] + detail::norm(detail::substruct(points[i], points[i - 1]));
+    }
+}
+
+template <typename T>
+inline void maxDistance(
+    const Curve3Controls<T>& controls,
+    const Point<T> points[],
+    const T tDist[],
+    int firstIdx,
+    int lastIdx,
+    T& maxDist,
+    int& maxDistIdx
+) {
+    maxDist = T(-1);
+    maxDistIdx = -1;
+    for (int i = firstIdx; i <= lastIdx; ++i) {
+        Point<T> approxPoint = evaluate<T>(controls, detail::tValue(tDist, i, firstIdx, lastIdx));
+        T dist = detail::norm(detail::substruct(approxPoint, points[i]));
+        if (dist > maxDist) {
+            maxDist = dist;
+            maxDistIdx = i;
+        }
+    }
+}
+
+template <typename T>
+inline int fitOneCurve(
+    const Point<T> points[],
+    const T tDist[],
+    int firstIdx,
+    int lastIdx,
+    const Point<T>& e1,
+    const Point<T>& e2,
+    Curve3Controls<T>& controls
+) {
+    const int pointsCount = lastIdx - firstIdx + 1;
+    if (pointsCount < 2) {
+        return BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
+    }
+
+    const Point<T>& p0 = points[firstIdx];
+    const Point<T>& p3 = points[lastIdx];
+    typename Traits<T>::FitSums sums = {};
+    for (int i = firstIdx; i <= lastIdx; ++i) {
+        detail::addFitPoint(sums, points[i], detail::tValue(tDist, i, firstIdx, lastIdx), p0, p3, e1, e2);
+    }
+    detail::solveFit(sums, p0, p3, e1, e2, controls);
+    return BEZIER_APPROX_OK;
+}
+
+// Same algorithm and result codes as bezierApprox.
+template <typename T>
+inline int fit(
+    const Point<T> points[],
+    int pointsSize,
+    T precision,
+    Curve3Controls<T>* controlsBuffer,
+    int* controlsBufferSize
+) {
+    if (pointsSize < 1) {
+        return BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
+    }
+    if (pointsSize == 1) {
+        if (*controlsBufferSize < 1) {
+            *controlsBufferSize = 1;
+            return BEZIER_APPROX_BUFFER_TOO_SMALL;
+        }
+        *controlsBufferSize = 1;
+        controlsBuffer[0] = Curve3Controls<T>{ points[0], points[0], points[0], points[0] };
+        return BEZIER_APPROX_OK;
+    }
+
+    Point<T> e1 = detail::substruct(points[1], points[0]);
+    Point<T> e2 = detail::substruct(points[pointsSize - 2], points[pointsSize - 1]);
+    if (!detail::normalize(e1) || !detail::normalize(e2)) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+
+    std::vector<T> tDist(pointsSize);
+    arcLengths(points, pointsSize, tDist.data());
+
+    std::vector<Curve3Controls<T>> controlsAns;
+    std::vector<detail::StackEntry<T>> controlsStack;
+    controlsStack.reserve(pointsSize - 1);
+
+    detail::StackEntry<T> entry;
+    entry.e1 = e1;
+    entry.e2 = e2;
+    entry.firstIdx = 0;
+    entry.lastIdx = pointsSize - 1;
+    int result = fitOneCurve(points, tDist.data(), 0, pointsSize - 1, e1, e2, entry.controls);
+    if (result != BEZIER_APPROX_OK) {
+        return result;
+    }
+    controlsStack.push_back(entry);
+
+    while (!controlsStack.empty()) {
+        entry = controlsStack.back();
+        controlsStack.pop_back();
+
+        T maxDist;
+        int maxDistIdx;
+        maxDistance(entry.controls, points, tDist.data(), entry.firstIdx, entry.lastIdx, maxDist, maxDistIdx);
+        if (maxDist <= precision) {
+            controlsAns.push_back(entry.controls);
+            continue;
+        }
+
+        Point<T> eSplit = detail::substruct(points[maxDistIdx + 1], points[maxDistIdx - 1]);
+        if (!detail::normalize(eSplit)) {
+            return BEZIER_APPROX_ARGUMENTS_ERROR;
+        }
+        Point<T> eSplitInv{ -eSplit.x, -eSplit.y };
+
+        detail::StackEntry<T> right;
+        right.e1 = eSplit;
+        right.e2 = entry.e2;
+        right.firstIdx = maxDistIdx;
+        right.lastIdx = entry.lastIdx;
+        result = fitOneCurve(points, tDist.data(), right.firstIdx, right.lastIdx, right.e1, right.e2, right.controls);
+        if (result != BEZIER_APPROX_OK) {
+            return result;
+        }
+
+        detail::StackEntry<T> left;
+        left.e1 = entry.e1;
+        left.e2 = eSplitInv;
+        left.firstIdx = entry.firstIdx;
+        left.lastIdx = maxDistIdx;
+        result = fitOneCurve(points, tDist.data(), left.firstIdx, left.lastIdx, left.e1, left.e2, left.controls);
+        if (result != BEZIER_APPROX_OK) {
+            return result;
+        }
+
+        controlsStack.push_back(right);
+        controlsStack.push_back(left);
+    }
+
+    const int controlsAnsSize = static_cast<int>(controlsAns.size());
+    if (controlsAnsSize > *controlsBufferSize) {
+        *controlsBufferSize = controlsAnsSize;
+        return BEZIER_APPROX_BUFFER_TOO_SMALL;
+    }
+    for (int i = 0; i < controlsAnsSize; ++i) {
+        controlsBuffer[i] = controlsAns[i];
+    }
+    *controlsBufferSize = controlsAnsSize;
+    return BEZIER_APPROX_OK;
+}
+
+} // namespace bezierapprox
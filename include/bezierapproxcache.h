@@ -0,0 +1,77 @@
+#pragma once
+
+#include "bezierapprox.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BEZIERAPPROXLIB_PUBLIC
+typedef struct _BezierApproxCacheStats {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    int entriesCount;
+    size_t bytesUsed;
+} BezierApproxCacheStats;
+
+typedef struct _BezierApproxCache BezierApproxCache;
+
+// Keeps up to capacityBytes of fitted curves, the least recently used are
+// evicted first. If path is not NULL, the entries saved there are loaded,
+// and bezierApproxCacheSave and bezierApproxCacheDestroy write them back.
+// On Windows the entries are not persisted: path is ignored on create and
+// bezierApproxCacheSave returns BEZIER_APPROX_FAILED.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxCacheCreate(
+    size_t capacityBytes,
+    const char* path,
+    BezierApproxCache** cache
+);
+
+// Same as bezierApproxWithTangents, but results are looked up by a 128 bit
+// hash of the points together with precision and the tangent options. The
+// hash is keyed by a random seed of the cache, which is saved with the
+// entries. The points themselves are not stored. Safe to call from several
+// threads.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxCacheFit(
+    BezierApproxCache* cache,
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int tangentEstimator,
+    int tangentWindow,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+);
+
+// Writes all entries to a temporary file next to path, memory mapped, and
+// renames it over path, so readers never see a partial file. Each shard is
+// copied under its own lock and the file is written without any, so fits
+// continue meanwhile and the saved shards may be from slightly different
+// moments. Processes sharing path don't merge their entries: the last one to
+// save replaces the file. Entries added since the last save are lost if the
+// process dies without destroying the cache.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxCacheSave(
+    BezierApproxCache* cache
+);
+
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxCacheGetStats(
+    BezierApproxCache* cache,
+    BezierApproxCacheStats* stats
+);
+
+// Saves the entries if the cache has a path, then frees it.
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxCacheDestroy(
+    BezierApproxCache* cache
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "bezierapprox.h"
+
+#include <math.h>
+
+#define BEZIER_APPROX_INLINE_EPS_ZERO 1.0e-9
+#define BEZIER_APPROX_INLINE_EPS_ZERO_F 1.0e-6f
+
+// Header only versions of the evaluation and one curve fitting functions.
+// They give the same results as the exported ones, but can be inlined into
+// the caller's loops instead of being called through the dynamic linker.
+// The library and bezierapprox.hpp are built on the same kernels.
+
+// All four Bernstein basis values of the cubic at once, without pow.
+static inline void bezierApproxInlineBasis(double t, double b[4]) {
+    const double mt = 1.0 - t;
+    b[0] = mt * mt * mt;
+    b[1] = 3.0 * mt * mt * t;
+    b[2] = 3.0 * mt * t * t;
+    b[3] = t * t * t;
+}
+
+static inline void bezierApproxInlineBasisF(float t, float b[4]) {
+    const float mt = 1.0f - t;
+    b[0] = mt * mt * mt;
+    b[1] = 3.0f * mt * mt * t;
+    b[2] = 3.0f * mt * t * t;
+    b[3] = t * t * t;
+}
+
+static inline BezierApproxPoint bezierApproxInlineGetCurveValue(
+    const BezierApproxCurve3Controls controls,
+    double t
+) {
+    double b[4];
+    bezierApproxInlineBasis(t, b);
+
+    BezierApproxPoint result;
+    result.x = b[0] * controls.P0.x + b[1] * controls.P1.x + b[2] * controls.P2.x + b[3] * controls.P3.x;
+    result.y = b[0] * controls.P0.y + b[1] * controls.P1.y + b[2] * controls.P2.y + b[3] * controls.P3.y;
+    return result;
+}
+
+static inline BezierApproxPointF bezierApproxInlineGetCurveValueF(
+    const BezierApproxCurve3ControlsF controls,
+    float t
+) {
+    float b[4];
+    bezierApproxInlineBasisF(t, b);
+
+    BezierApproxPointF result;
+    result.x = b[0] * controls.P0.x + b[1] * controls.P1.x + b[2] * controls.P2.x + b[3] * controls.P3.x;
+    result.y = b[0] * controls.P0.y + b[1] * controls.P1.y + b[2] * controls.P2.y + b[3] * controls.P3.y;
+    return result;
+}
+
+// Normal equations of the least squares fit of the inner control points,
+// P1 = P0 + z1 * e1 and P2 = P3 + z2 * e2. Every point of the segment is
+// added at its parameter, then the sums are solved for z1 and z2.
+typedef struct _BezierApproxInlineFitSums {
+    double A11;
+    double A12;
+    double A22;
+    double D1;
+    double D2;
+} BezierApproxInlineFitSums;
+
+typedef struct _BezierApproxInlineFitSumsF {
+    float A11;
+    float A12;
+    float A22;
+    float D1;
+    float D2;
+} BezierApproxInlineFitSumsF;
+
+static inline void bezierApproxInlineAddFitPoint(
+    BezierApproxInlineFitSums* sums,
+    const BezierApproxPoint point,
+    double t,
+    const BezierApproxPoint p0,
+    const BezierApproxPoint p3,
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2
+) {
+    double b[4];
+    bezierApproxInlineBasis(t, b);
+
+    sums->A11 += b[1] * b[1];
+    sums->A12 += b[1] * b[2];
+    sums->A22 += b[2] * b[2];
+
+    const double dPart1 = point.x - p0.x * (b[0] + b[1]) - p3.x * (b[2] + b[3]);
+    const double dPart2 = point.y - p0.y * (b[0] + b[1]) - p3.y * (b[2] + b[3]);
+    sums->D1 += (dPart1 * e1.x + dPart2 * e1.y) * b[1];
+    sums->D2 += (dPart1 * e2.x + dPart2 * e2.y) * b[2];
+}
+
+static inline void bezierApproxInlineAddFitPointF(
+    BezierApproxInlineFitSumsF* sums,
+    const BezierApproxPointF point,
+    float t,
+    const BezierApproxPointF p0,
+    const BezierApproxPointF p3,
+    const BezierApproxPointF e1,
+    const BezierApproxPointF e2
+) {
+    float b[4];
+    bezierApproxInlineBasisF(t, b);
+
+    sums->A11 += b[1] * b[1];
+    sums->A12 += b[1] * b[2];
+    sums->A22 += b[2] * b[2];
+
+    const float dPart1 = point.x - p0.x * (b[0] + b[1]) - p3.x * (b[2] + b[3]);
+    const float dPart2 = point.y - p0.y * (b[0] + b[1]) - p3.y * (b[2] + b[3]);
+    sums->D1 += (dPart1 * e1.x + dPart2 * e1.y) * b[1];
+    sums->D2 += (dPart1 * e2.x + dPart2 * e2.y) * b[2];
+}
+
+// Falls back to unit magnitudes if the system is degenerate, which also
+// covers segments of two points.
+static inline void bezierApproxInlineSolveFit(
+    const BezierApproxInlineFitSums* sums,
+    const BezierApproxPoint p0,
+    const BezierApproxPoint p3,
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2,
+    BezierApproxCurve3Controls* controls
+) {
+    const double A12 = (e1.x * e2.x + e1.y * e2.y) * sums->A12;
+    const double detA = sums->A11 * sums->A22 - A12 * A12;
+    double z1 = 1.0;
+    double z2 = 1.0;
+    if (fabs(detA) >= BEZIER_APPROX_INLINE_EPS_ZERO) {
+        z1 = (sums->A22 * sums->D1 - A12 * sums->D2) / detA;
+        z2 = (sums->A11 * sums->D2 - A12 * sums->D1) / detA;
+    }
+
+    controls->P0 = p0;
+    controls->P1.x = p0.x + z1 * e1.x;
+    controls->P1.y = p0.y + z1 * e1.y;
+    controls->P2.x = p3.x + z2 * e2.x;
+    controls->P2.y = p3.y + z2 * e2.y;
+    controls->P3 = p3;
+}
+
+static inline void bezierApproxInlineSolveFitF(
+    const BezierApproxInlineFitSumsF* sums,
+    const BezierApproxPointF p0,
+    const BezierApproxPointF p3,
+    const BezierApproxPointF e1,
+    const BezierApproxPointF e2,
+    BezierApproxCurve3ControlsF* controls
+) {
+    const float A12 = (e1.x * e2.x + e1.y * e2.y) * sums->A12;
+    const float detA = sums->A11 * sums->A22 - A12 * A12;
+    float z1 = 1.0f;
+    float z2 = 1.0f;
+    if (fabsf(detA) >= BEZIER_APPROX_INLINE_EPS_ZERO_F) {
+        z1 = (sums->A22 * sums->D1 - A12 * sums->D2) / detA;
+        z2 = (sums->A11 * sums->D2 - A12 * sums->D1) / detA;
+    }
+
+    controls->P0 = p0;
+    controls->P1.x = p0.x + z1 * e1.x;
+    controls->P1.y = p0.y + z1 * e1.y;
+    controls->P2.x = p3.x + z2 * e2.x;
+    controls->P2.y = p3.y + z2 * e2.y;
+    controls->P3 = p3;
+}
+
+// Arc length parameters are recomputed on the fly, so no memory is allocated.
+static inline int bezierApproxInlineByOneCurve(
+    const BezierApproxPoint points[],
+    int firstPointIndex,
+    int lastPointIndex,
+    BezierApproxCurve3Controls* controls
+) {
+    if (firstPointIndex + 1 > lastPointIndex) {
+        return BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
+    }
+
+    const BezierApproxPoint p0 = points[firstPointIndex];
+    const BezierApproxPoint p3 = points[lastPointIndex];
+
+    BezierApproxPoint e1;
+    e1.x = points[firstPointIndex + 1].x - p0.x;
+    e1.y = points[firstPointIndex + 1].y - p0.y;
+    double e1Norm = sqrt(e1.x * e1.x + e1.y * e1.y);
+    if (e1Norm < BEZIER_APPROX_INLINE_EPS_ZERO) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    e1.x /= e1Norm;
+    e1.y /= e1Norm;
+
+    BezierApproxPoint e2;
+    e2.x = points[lastPointIndex - 1].x - p3.x;
+    e2.y = points[lastPointIndex - 1].y - p3.y;
+    double e2Norm = sqrt(e2.x * e2.x + e2.y * e2.y);
+    if (e2Norm < BEZIER_APPROX_INLINE_EPS_ZERO) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    e2.x /= e2Norm;
+    e2.y /= e2Norm;
+
+    double length = 0.0;
+    for (int i = firstPointIndex + 1; i <= lastPointIndex; ++i) {
+        double dx = points[i].x - points[i - 1].x;
+        double dy = points[i].y - points[i - 1].y;
+        length += sqrt(dx * dx + dy * dy);
+    }
+
+    BezierApproxInlineFitSums sums = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double dist = 0.0;
+    for (int i = firstPointIndex; i <= lastPointIndex; ++i) {
+        if (i > firstPointIndex) {
+            double dx = points[i].x - points[i - 1].x;
+            double dy = points[i].y - points[i - 1].y;
+            dist += sqrt(dx * dx + dy * dy);
+        }
+        bezierApproxInlineAddFitPoint(&sums, points[i], dist / length, p0, p3, e1, e2);
+    }
+    bezierApproxInlineSolveFit(&sums, p0, p3, e1, e2, controls);
+    return BEZIER_APPROX_OK;
+}
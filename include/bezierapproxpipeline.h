@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bezierapprox.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called on a worker thread when a polyline is fitted. Calls for one stream
+// are made in submission order and never concurrently. No pipeline lock is
+// held during the call, so the callback may submit, into its own stream too,
+// but a slow callback holds back the later results of its stream. The
+// result in the call doesn't count toward the limit of undelivered
+// polylines of the stream, so a callback that submits one polyline per
+// call into a stream only it feeds always finds room in it. Otherwise,
+// once the stream is at the limit, its submissions are refused until the
+// callback returns, so the callback must not retry them in a loop.
+// controls is valid only during the call.
+typedef void (*BezierApproxPipelineCallback)(
+    void* userData,
+    int streamId,
+    unsigned long long sequence,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize
+);
+
+BEZIERAPPROXLIB_PUBLIC
+typedef struct _BezierApproxPipelineStats {
+    unsigned long long submitted;
+    unsigned long long rejected;
+    unsigned long long completed;
+    int queueDepth;
+    double meanLatency;
+    double p99Latency;
+    double maxLatency;
+} BezierApproxPipelineStats;
+
+typedef struct _BezierApproxPipeline BezierApproxPipeline;
+
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxPipelineCreate(
+    int workersCount,
+    int queueCapacity,
+    int streamsCount,
+    BezierApproxPipelineCallback callback,
+    void* userData,
+    BezierApproxPipeline** pipeline
+);
+
+// Queues a polyline without blocking. The points are not copied and must
+// stay alive until the callback for this submission. Returns
+// BEZIER_APPROX_QUEUE_FULL when the queue is full or the stream has too many
+// undelivered polylines, the caller should retry.
+BEZIERAPPROXLIB_PUBLIC
+int bezierApproxPipelineSubmit(
+    BezierApproxPipeline* pipeline,
+    int streamId,
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision
+);
+
+// Waits until every submitted polyline is delivered. Must not be called
+// from the callback.
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxPipelineFlush(
+    BezierApproxPipeline* pipeline
+);
+
+// Latencies are in seconds, from submission to the end of the callback.
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxPipelineGetStats(
+    BezierApproxPipeline* pipeline,
+    BezierApproxPipelineStats* stats
+);
+
+// Delivers the queued polylines and stops the workers.
+BEZIERAPPROXLIB_PUBLIC
+void bezierApproxPipelineDestroy(
+    BezierApproxPipeline* pipeline
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,30 +1,57 @@
 #include "bezierapprox.h"
+#include "bezierapproxinline.h"
+#include "bezierapproxprivate.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
-#define EPS_ZERO 1.0e-9
-
-const double B3[] = {
-    1,
-    3,
-    3,
-    1
-};
+#define BUDGET_CHECK_PERIOD 32
+// Passed as refineIterations when the error is measured at the chord length
+// parameters and nothing is refined.
+#define CHORD_LENGTH_METRIC -1
+// Curves whose chord length error is within this factor of the precision
+// are refined before they are split.
+#define REFINE_MARGIN 2.0
 
+// The distance is measured when the entry is fitted, so an interrupted fit
+// reports the error of its unchecked curves without another pass.
 typedef struct _BezierControlsStackEntry {
     BezierApproxCurve3Controls controls;
     BezierApproxPoint e1;
     BezierApproxPoint e2;
     int fistIdx;
     int lastIdx;
+    double maxDist;
+    int maxDistIdx;
 } BezierControlsStackEntry;
 
-static inline double bValue(int j, double t) {
-    return B3[j] * pow(1 - t, 3 - j) * pow(t, j);
-}
+typedef struct _BezierApproxBudget {
+    double deadline;
+    BezierApproxCancelCallback isCancelled;
+    void* userData;
+} BezierApproxBudget;
+
+// Everything the public entry points add to the plain fit. Each of them
+// zeroes it and fills only its own fields, zero means the plain behaviour.
+typedef struct _BezierApproxOptions {
+    const BezierApproxBudget* budget;
+    int tangentEstimator;
+    int tangentWindow;
+    // refineIterations is used only if orthogonal is set.
+    int orthogonal;
+    int refineIterations;
+    const double* seedFractions;
+    int seedFractionsSize;
+    int* splitIndicesBuffer;
+    double* splitFractionsBuffer;
+    int* keptIndicesBuffer;
+    int* keptIndicesSize;
+    double* maxError;
+    BezierApproxScratch* scratch;
+} BezierApproxOptions;
 
 static inline BezierApproxPoint substructPoint(BezierApproxPoint a, BezierApproxPoint b) {
     BezierApproxPoint c;
@@ -47,12 +74,24 @@ static inline int normalizePoint(BezierApproxPoint *a) {
     return BEZIER_APPROX_OK;
 }
 
+static inline BezierApproxPoint getPoint(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    int idx
+) {
+    return pointIndices ? points[pointIndices[idx]] : points[idx];
+}
+
+// Fills tDistBuffer if it is not NULL, otherwise allocates the result.
 static inline double* initTdist(
     const BezierApproxPoint points[],
-    int pointsSize
+    int pointsSize,
+    double* tDistBuffer
 ) {
-    double* tDist = NULL;
-    tDist = (double*)malloc(pointsSize * sizeof(double));
+    double* tDist = tDistBuffer;
+    if (!tDist) {
+        tDist = (double*)malloc(pointsSize * sizeof(double));
+    }
     if (!tDist) {
         return tDist;
     }
@@ -65,6 +104,44 @@ static inline double* initTdist(
     return tDist;
 }
 
+// Fills pointIndices with the indices of the points that are kept: NaNs and
+// points at zero distance from the previous kept one are skipped.
+static inline double* initTdistSanitized(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    int* pointIndices,
+    int* pointIndicesSize
+) {
+    double* tDist = NULL;
+    tDist = (double*)malloc(pointsSize * sizeof(double));
+    if (!tDist) {
+        return tDist;
+    }
+
+    *pointIndicesSize = 0;
+    for (int i = 0; i < pointsSize; ++i) {
+        if (isnan(points[i].x) || isnan(points[i].y)) {
+            continue;
+        }
+        if (*pointIndicesSize == 0) {
+            tDist[0] = 0.0;
+            pointIndices[0] = i;
+            *pointIndicesSize = 1;
+            continue;
+        }
+        const int lastIdx = *pointIndicesSize - 1;
+        BezierApproxPoint diff = substructPoint(points[i], points[pointIndices[lastIdx]]);
+        double norm = getPointNorm(&diff);
+        if (norm < EPS_ZERO) {
+            continue;
+        }
+        tDist[lastIdx + 1] = tDist[lastIdx] + norm;
+        pointIndices[lastIdx + 1] = i;
+        ++*pointIndicesSize;
+    }
+    return tDist;
+}
+
 static inline double getTValue(
     const double tDist[],
     int idx,
@@ -78,7 +155,9 @@ static inline double getTValue(
 static inline void getMaxDistance(
     const BezierApproxCurve3Controls controls,
     const BezierApproxPoint points[],
+    const int pointIndices[],
     const double tDist[],
+    const double tValues[],
     int firstIdx,
     int lastIdx,
     double *maxDist,
@@ -87,9 +166,9 @@ static inline void getMaxDistance(
     *maxDist = -1.0;
     *maxDistIdx = -1;
     for (int i = firstIdx; i <= lastIdx; ++i) {
-        double tVal = getTValue(tDist, i, firstIdx, lastIdx);
-        BezierApproxPoint approxPoint = bezierApproxGetCurveValue(controls, tVal);
-        BezierApproxPoint diffVect = substructPoint(approxPoint, points[i]);
+        double tVal = tValues ? tValues[i] : getTValue(tDist, i, firstIdx, lastIdx);
+        BezierApproxPoint approxPoint = bezierApproxInlineGetCurveValue(controls, tVal);
+        BezierApproxPoint diffVect = substructPoint(approxPoint, getPoint(points, pointIndices, i));
         double dist = getPointNorm(&diffVect);
         if (dist > *maxDist) {
             *maxDist = dist;
@@ -101,13 +180,20 @@ static inline void getMaxDistance(
     assert(*maxDistIdx <= lastIdx);
 }
 
+#if BEZIERAPPROXLIB_FIT_STATS
+// Counted per thread, so concurrent fits don't write to a shared line.
+static _Thread_local BezierApproxFitStats fitStats = { 0, 0 };
+#endif
+
 static int inline bezierApproxByOneCurveByInitVectors(
     const BezierApproxPoint points[],
+    const int pointIndices[],
     int firstPointIndex,
     int lastPointIndex,
     const BezierApproxPoint e1,
     const BezierApproxPoint e2,
     const double tDist[],
+    const double tValues[],
     BezierApproxCurve3Controls* controls
 ) {
     int result = BEZIER_APPROX_FAILED;
@@ -117,332 +203,1477 @@ static int inline bezierApproxByOneCurveByInitVectors(
         result = BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
         goto cleanup;
     }
+#if BEZIERAPPROXLIB_FIT_STATS
+    ++fitStats.fitsCount;
+    fitStats.fittedPointsCount += pointsCount;
+#endif
 
-    double z1 = 0.0;
-    double z2 = 0.0;
-    double x0 = points[firstPointIndex].x;
-    double y0 = points[firstPointIndex].y;
-    double x3 = points[lastPointIndex].x;
-    double y3 = points[lastPointIndex].y;
-
-    if (pointsCount == 2) {
-        z1 = 1.0;
-        z2 = 1.0;
-        goto fillcontrols;
+    const BezierApproxPoint p0 = getPoint(points, pointIndices, firstPointIndex);
+    const BezierApproxPoint p3 = getPoint(points, pointIndices, lastPointIndex);
+    BezierApproxInlineFitSums sums = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    for (int i = firstPointIndex; i <= lastPointIndex; ++i) {
+        double tVal = tValues ? tValues[i] : getTValue(tDist, i, firstPointIndex, lastPointIndex);
+        bezierApproxInlineAddFitPoint(&sums, getPoint(points, pointIndices, i), tVal, p0, p3, e1, e2);
     }
+    bezierApproxInlineSolveFit(&sums, p0, p3, e1, e2, controls);
 
-    double A11 = 0.0;
-    double A12 = 0.0;
-    double A22 = 0.0;
-    double D1 = 0.0;
-    double D2 = 0.0;
-    for (int i = firstPointIndex; i <= lastPointIndex; ++i) {
-        double tVal = getTValue(tDist, i, firstPointIndex, lastPointIndex);
+    result = BEZIER_APPROX_OK;
+cleanup:
+    return result;
+}
 
-        double b0Val = bValue(0, tVal);
-        double b1Val = bValue(1, tVal);
-        double b2Val = bValue(2, tVal);
-        double b3Val = bValue(3, tVal);
+// One Newton step on (B(t) - P) . B'(t) = 0 for every inner point, moving
+// its parameter towards the closest point of the curve. The points are read
+// directly, a flat denominator is replaced by an infinite one that gives a
+// zero step, and the quiet comparisons can be turned into selects, so the
+// loop vectorizes.
+static inline void refineTValues(
+    const BezierApproxCurve3Controls controls,
+    const BezierApproxPoint points[],
+    int firstIdx,
+    int lastIdx,
+    double tValues[]
+) {
+    const double d10x = 3.0 * (controls.P1.x - controls.P0.x);
+    const double d10y = 3.0 * (controls.P1.y - controls.P0.y);
+    const double d21x = 3.0 * (controls.P2.x - controls.P1.x);
+    const double d21y = 3.0 * (controls.P2.y - controls.P1.y);
+    const double d32x = 3.0 * (controls.P3.x - controls.P2.x);
+    const double d32y = 3.0 * (controls.P3.y - controls.P2.y);
 
-        A11 += b1Val * b1Val;
-        A12 += b1Val * b2Val;
-        A22 += b2Val * b2Val;
+    for (int i = firstIdx + 1; i < lastIdx; ++i) {
+        const double t = tValues[i];
+        const double mt = 1.0 - t;
 
-        double a = points[i].x;
-        double b = points[i].y;
+        const double b0 = mt * mt * mt;
+        const double b1 = 3.0 * mt * mt * t;
+        const double b2 = 3.0 * mt * t * t;
+        const double b3 = t * t * t;
+        const double diffX = b0 * controls.P0.x + b1 * controls.P1.x + b2 * controls.P2.x + b3 * controls.P3.x - points[i].x;
+        const double diffY = b0 * controls.P0.y + b1 * controls.P1.y + b2 * controls.P2.y + b3 * controls.P3.y - points[i].y;
 
-        double dPart1 = a - x0 * (b0Val + b1Val) - x3 * (b2Val + b3Val);
-        double dPart2 = b - y0 * (b0Val + b1Val) - y3 * (b2Val + b3Val);
+        const double firstX = mt * mt * d10x + 2.0 * mt * t * d21x + t * t * d32x;
+        const double firstY = mt * mt * d10y + 2.0 * mt * t * d21y + t * t * d32y;
+        const double secondX = 2.0 * (mt * (d21x - d10x) + t * (d32x - d21x));
+        const double secondY = 2.0 * (mt * (d21y - d10y) + t * (d32y - d21y));
 
-        D1 += dPart1 * e1.x * b1Val + dPart2 * e1.y * b1Val;
-        D2 += dPart1 * e2.x * b2Val + dPart2 * e2.y * b2Val;
+        const double numerator = diffX * firstX + diffY * firstY;
+        const double denominator = firstX * firstX + firstY * firstY + diffX * secondX + diffY * secondY;
+        const double safeDenominator = isgreater(fabs(denominator), EPS_ZERO) ? denominator : HUGE_VAL;
+        const double refined = t - numerator / safeDenominator;
+        const double clamped = isless(refined, 0.0) ? 0.0 : refined;
+        tValues[i] = isgreater(clamped, 1.0) ? 1.0 : clamped;
     }
-    A12 = (e1.x * e2.x + e1.y * e2.y) * A12;
+}
 
-    double detA = A11 * A22 - A12 * A12;
-    if (fabs(detA) < EPS_ZERO) {
-        z1 = 1.0;
-        z2 = 1.0;
-        goto fillcontrols;
+// Reparameterizes the points of the entry by their closest curve points and
+// refits it, refineIterations times, then moves the parameters once more to
+// measure the final curve.
+static inline int refineEntry(
+    const BezierApproxPoint points[],
+    const double tDist[],
+    double tValues[],
+    int refineIterations,
+    BezierControlsStackEntry* entry
+) {
+    for (int i = entry->fistIdx; i <= entry->lastIdx; ++i) {
+        tValues[i] = getTValue(tDist, i, entry->fistIdx, entry->lastIdx);
     }
+    for (int k = 0; k < refineIterations; ++k) {
+        refineTValues(entry->controls, points, entry->fistIdx, entry->lastIdx, tValues);
+        int result = bezierApproxByOneCurveByInitVectors(
+            points,
+            NULL,
+            entry->fistIdx,
+            entry->lastIdx,
+            entry->e1,
+            entry->e2,
+            tDist,
+            tValues,
+            &entry->controls
+        );
+        if (result != BEZIER_APPROX_OK) {
+            return result;
+        }
+    }
+    refineTValues(entry->controls, points, entry->fistIdx, entry->lastIdx, tValues);
+    getMaxDistance(
+        entry->controls, points, NULL, tDist, tValues,
+        entry->fistIdx, entry->lastIdx, &entry->maxDist, &entry->maxDistIdx
+    );
+    return BEZIER_APPROX_OK;
+}
 
-    z1 = (A22 * D1 - A12 * D2) / detA;
-    z2 = (A11 * D2 - A12 * D1) / detA;
-
-fillcontrols:
-    controls->P0.x = x0;
-    controls->P0.y = y0;
-    controls->P1.x = x0 + z1 * e1.x;
-    controls->P1.y = y0 + z1 * e1.y;
-    controls->P2.x = x3 + z2 * e2.x;
-    controls->P2.y = y3 + z2 * e2.y;
-    controls->P3.x = x3;
-    controls->P3.y = y3;
+static inline int fitEntry(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const double tDist[],
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2,
+    int firstIdx,
+    int lastIdx,
+    BezierControlsStackEntry* entry
+) {
+    entry->e1 = e1;
+    entry->e2 = e2;
+    entry->fistIdx = firstIdx;
+    entry->lastIdx = lastIdx;
+    int result = bezierApproxByOneCurveByInitVectors(
+        points,
+        pointIndices,
+        firstIdx,
+        lastIdx,
+        e1,
+        e2,
+        tDist,
+        NULL,
+        &entry->controls
+    );
+    if (result != BEZIER_APPROX_OK) {
+        return result;
+    }
+    getMaxDistance(
+        entry->controls,
+        points,
+        pointIndices,
+        tDist,
+        NULL,
+        firstIdx,
+        lastIdx,
+        &entry->maxDist,
+        &entry->maxDistIdx
+    );
+    return BEZIER_APPROX_OK;
+}
 
-    result = BEZIER_APPROX_OK;
-cleanup:
-    return result;
+static inline BezierApproxPoint getSplitTangent(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxPoint tangents[],
+    int idx
+) {
+    if (tangents) {
+        return tangents[idx];
+    }
+    return substructPoint(
+        getPoint(points, pointIndices, idx + 1),
+        getPoint(points, pointIndices, idx - 1)
+    );
 }
 
-int bezierApprox(
+static inline int getBoundaryTangents(
     const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxPoint tangents[],
     int pointsSize,
-    double precision,
-    BezierApproxCurve3Controls* controlsBuffer,
-    int* controlsBufferSize
+    int firstIdx,
+    int lastIdx,
+    BezierApproxPoint* e1,
+    BezierApproxPoint* e2
 ) {
-    int result = BEZIER_APPROX_FAILED;
-    double* tDist = NULL;
+    if (firstIdx == 0 && !tangents) {
+        *e1 = substructPoint(
+            getPoint(points, pointIndices, 1),
+            getPoint(points, pointIndices, 0)
+        );
+    }
+    else {
+        *e1 = getSplitTangent(points, pointIndices, tangents, firstIdx);
+    }
+    if (normalizePoint(e1) != BEZIER_APPROX_OK) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
 
-    const int controlsAnsCapacity = pointsSize - 1;
-    int controlsAnsSize = 0;
-    BezierApproxCurve3Controls* controlsAns = NULL;
+    if (lastIdx == pointsSize - 1 && !tangents) {
+        *e2 = substructPoint(
+            getPoint(points, pointIndices, pointsSize - 2),
+            getPoint(points, pointIndices, pointsSize - 1)
+        );
+    }
+    else {
+        *e2 = getSplitTangent(points, pointIndices, tangents, lastIdx);
+        e2->x = -e2->x;
+        e2->y = -e2->y;
+    }
+    if (normalizePoint(e2) != BEZIER_APPROX_OK) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    return BEZIER_APPROX_OK;
+}
 
-    const int controlsStackCapacity = pointsSize - 1;
-    int controlsStackSize = 0;
-    BezierControlsStackEntry *controlsStack = NULL;
+static inline double getTimeSeconds() {
+    struct timespec ts;
+    if (!timespec_get(&ts, TIME_UTC)) {
+        return 0.0;
+    }
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
 
-    if (pointsSize < 1) {
-        result = BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
-        goto cleanup;
+static inline void initBudget(
+    double timeBudget,
+    BezierApproxCancelCallback isCancelled,
+    void* userData,
+    BezierApproxBudget* budget
+) {
+    budget->deadline = timeBudget > 0.0 ? getTimeSeconds() + timeBudget : 0.0;
+    budget->isCancelled = isCancelled;
+    budget->userData = userData;
+}
+
+static inline int isBudgetExhausted(
+    const BezierApproxBudget* budget,
+    int iteration
+) {
+    if (!budget) {
+        return 0;
     }
-    if (pointsSize == 1) {
-        if (*controlsBufferSize < 1) {
-            result = BEZIER_APPROX_BUFFER_TOO_SMALL;
-            *controlsBufferSize = controlsAnsSize;
-            goto cleanup;
+    if (budget->isCancelled && budget->isCancelled(budget->userData)) {
+        return 1;
+    }
+    return budget->deadline > 0.0 &&
+        iteration % BUDGET_CHECK_PERIOD == 0 &&
+        getTimeSeconds() >= budget->deadline;
+}
+
+static inline int getSegmentTangents(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxPoint tangents[],
+    int pointsSize,
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2,
+    int firstIdx,
+    int lastIdx,
+    BezierApproxPoint* segmentE1,
+    BezierApproxPoint* segmentE2
+) {
+    *segmentE1 = e1;
+    if (firstIdx > 0) {
+        *segmentE1 = getSplitTangent(points, pointIndices, tangents, firstIdx);
+        if (normalizePoint(segmentE1) != BEZIER_APPROX_OK) {
+            return BEZIER_APPROX_ARGUMENTS_ERROR;
         }
-        *controlsBufferSize = 1;
-        controlsBuffer[0].P0.x = points[0].x;
-        controlsBuffer[0].P0.y = points[0].y;
-        controlsBuffer[0].P1.x = points[0].x;
-        controlsBuffer[0].P1.y = points[0].y;
-        controlsBuffer[0].P2.x = points[0].x;
-        controlsBuffer[0].P2.y = points[0].y;
-        controlsBuffer[0].P3.x = points[0].x;
-        controlsBuffer[0].P3.y = points[0].y;
-        result = BEZIER_APPROX_OK;
-        goto cleanup;
     }
 
-    BezierApproxPoint e1 = substructPoint(points[1], points[0]);
-    if (normalizePoint(&e1) != BEZIER_APPROX_OK) {
-        result = BEZIER_APPROX_ARGUMENTS_ERROR;
-        goto cleanup;
+    *segmentE2 = e2;
+    if (lastIdx < pointsSize - 1) {
+        *segmentE2 = getSplitTangent(points, pointIndices, tangents, lastIdx);
+        if (normalizePoint(segmentE2) != BEZIER_APPROX_OK) {
+            return BEZIER_APPROX_ARGUMENTS_ERROR;
+        }
+        segmentE2->x = -segmentE2->x;
+        segmentE2->y = -segmentE2->y;
     }
+    return BEZIER_APPROX_OK;
+}
 
-    BezierApproxPoint e2 = substructPoint(points[pointsSize - 2], points[pointsSize - 1]);
-    if (normalizePoint(&e2) != BEZIER_APPROX_OK) {
-        result = BEZIER_APPROX_ARGUMENTS_ERROR;
-        goto cleanup;
+static int mergeSeededSplits(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxPoint tangents[],
+    int pointsSize,
+    const double tDist[],
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2,
+    double precision,
+    const int seeds[],
+    int seedsSize,
+    BezierApproxCurve3Controls* controlsAns,
+    int* splitsAns,
+    int* controlsAnsSize,
+    double* maxError
+) {
+    int mergedSize = 0;
+    int seedIdx = 0;
+    for (int i = 0; i < *controlsAnsSize; ++i) {
+        while (seedIdx < seedsSize && seeds[seedIdx] < splitsAns[i]) {
+            ++seedIdx;
+        }
+        if (mergedSize > 0 && seedIdx < seedsSize && seeds[seedIdx] == splitsAns[i]) {
+            const int firstIdx = splitsAns[mergedSize - 1];
+            const int lastIdx = splitsAns[i + 1];
+            BezierApproxPoint segmentE1;
+            BezierApproxPoint segmentE2;
+            int result = getSegmentTangents(
+                points, pointIndices, tangents, pointsSize, e1, e2, firstIdx, lastIdx, &segmentE1, &segmentE2
+            );
+            if (result != BEZIER_APPROX_OK) {
+                return result;
+            }
+
+            BezierApproxCurve3Controls controls;
+            result = bezierApproxByOneCurveByInitVectors(
+                points, pointIndices, firstIdx, lastIdx, segmentE1, segmentE2, tDist, NULL, &controls
+            );
+            if (result != BEZIER_APPROX_OK) {
+                return result;
+            }
+
+            double maxDist;
+            int maxDistIdx;
+            getMaxDistance(controls, points, pointIndices, tDist, NULL, firstIdx, lastIdx, &maxDist, &maxDistIdx);
+            if (maxDist <= precision) {
+                controlsAns[mergedSize - 1] = controls;
+                if (maxError && maxDist > *maxError) {
+                    *maxError = maxDist;
+                }
+                continue;
+            }
+        }
+        controlsAns[mergedSize] = controlsAns[i];
+        splitsAns[mergedSize] = splitsAns[i];
+        ++mergedSize;
     }
+    splitsAns[mergedSize] = pointsSize - 1;
+    *controlsAnsSize = mergedSize;
+    return BEZIER_APPROX_OK;
+}
 
-    controlsAns = (BezierApproxCurve3Controls*)malloc(
-        sizeof(BezierApproxCurve3Controls) * controlsAnsCapacity
-    );
+TARGET_CLONES
+static int approxRange(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxPoint tangents[],
+    int pointsSize,
+    const double tDist[],
+    BezierControlsStackEntry* controlsStackBuffer,
+    const BezierApproxPoint e1,
+    const BezierApproxPoint e2,
+    double precision,
+    const BezierApproxBudget* budget,
+    int refineIterations,
+    const int seeds[],
+    int seedsSize,
+    BezierApproxCurve3Controls* controlsAns,
+    int* splitsAns,
+    int* controlsAnsSize,
+    double* maxError
+) {
+    int result = BEZIER_APPROX_FAILED;
+    int iteration = 0;
 
-    if (!controlsAns) {
+    *controlsAnsSize = 0;
+
+    const int controlsStackCapacity = pointsSize - 1;
+    int controlsStackSize = 0;
+    BezierControlsStackEntry *controlsStack = controlsStackBuffer;
+    double* tValues = NULL;
+
+    if (!controlsStack) {
+        controlsStack = (BezierControlsStackEntry*)malloc(
+            sizeof(BezierControlsStackEntry) * controlsStackCapacity
+        );
+    }
+    if (!controlsStack) {
         goto cleanup;
     }
 
-    tDist = initTdist(points, pointsSize);
-    if (!tDist) {
-        goto cleanup;
+    // Entries on the stack never share inner points, so one array holds the
+    // refined parameters of all of them. Only unsanitized points are refined.
+    assert(refineIterations == CHORD_LENGTH_METRIC || !pointIndices);
+    if (refineIterations != CHORD_LENGTH_METRIC) {
+        tValues = (double*)malloc(sizeof(double) * pointsSize);
+        if (!tValues) {
+            goto cleanup;
+        }
     }
 
-    int leftIdx = 0;
-    int rightIdx = pointsSize - 1;
+    // Seeded segments are pushed from right to left, so the leftmost one is
+    // checked first and the answer stays ordered.
+    for (int k = seedsSize; k >= 0; --k) {
+        const int firstIdx = k > 0 ? seeds[k - 1] : 0;
+        const int lastIdx = k < seedsSize ? seeds[k] : pointsSize - 1;
+        BezierApproxPoint segmentE1;
+        BezierApproxPoint segmentE2;
+        result = getSegmentTangents(
+            points, pointIndices, tangents, pointsSize, e1, e2, firstIdx, lastIdx, &segmentE1, &segmentE2
+        );
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
 
-    BezierApproxCurve3Controls controls = {
-        {0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}
-    };
-    result = bezierApproxByOneCurveByInitVectors(
-        points,
-        0,
-        pointsSize - 1,
-        e1,
-        e2,
-        tDist,
-        &controls
-    );
-    if (result != BEZIER_APPROX_OK) {
-        goto cleanup;
+        assert(controlsStackSize + 1 <= controlsStackCapacity);
+        result = fitEntry(
+            points,
+            pointIndices,
+            tDist,
+            segmentE1,
+            segmentE2,
+            firstIdx,
+            lastIdx,
+            &controlsStack[controlsStackSize]
+        );
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+        ++controlsStackSize;
     }
+    result = BEZIER_APPROX_FAILED;
 
-    controlsStack = (BezierControlsStackEntry*)malloc(
-        sizeof(BezierControlsStackEntry) * controlsStackCapacity
-    );
-    if (!controlsStack) {
-        goto cleanup;
+    if (maxError) {
+        *maxError = 0.0;
     }
 
-    controlsStack[0].controls = controls;
-    controlsStack[0].e1 = e1;
-    controlsStack[0].e2 = e2;
-    controlsStack[0].fistIdx = 0;
-    controlsStack[0].lastIdx = pointsSize - 1;
-    controlsStackSize = 1;
-
     while (controlsStackSize > 0) {
+        if (isBudgetExhausted(budget, iteration++)) {
+            break;
+        }
         --controlsStackSize;
         BezierControlsStackEntry entry = controlsStack[controlsStackSize];
-        double maxDist;
-        int maxDistIdx;
-        getMaxDistance(entry.controls, points, tDist, entry.fistIdx, entry.lastIdx, &maxDist, &maxDistIdx);
+        // The chord length distance bounds the distance to the closest point,
+        // so only curves that miss the precision by a small margin are worth
+        // refining, the rest are split right away.
+        if (tValues && entry.maxDist > precision && entry.maxDist <= precision * REFINE_MARGIN) {
+            BezierControlsStackEntry refined = entry;
+            result = refineEntry(points, tDist, tValues, refineIterations, &refined);
+            if (result != BEZIER_APPROX_OK) {
+                goto cleanup;
+            }
+            result = BEZIER_APPROX_FAILED;
+            if (refined.maxDist <= precision) {
+                entry = refined;
+            }
+        }
+        const double maxDist = entry.maxDist;
+        const int maxDistIdx = entry.maxDistIdx;
         if (maxDist <= precision) {
-            assert(controlsAnsSize + 1 <= controlsAnsCapacity);
-            controlsAns[controlsAnsSize] = entry.controls;
-            ++controlsAnsSize;
+            assert(*controlsAnsSize + 1 <= pointsSize - 1);
+            controlsAns[*controlsAnsSize] = entry.controls;
+            if (splitsAns) {
+                splitsAns[*controlsAnsSize] = entry.fistIdx;
+            }
+            ++*controlsAnsSize;
+            if (maxError && maxDist > *maxError) {
+                *maxError = maxDist;
+            }
             continue;
         }
 
-        BezierApproxPoint eSplit = substructPoint(points[maxDistIdx + 1], points[maxDistIdx - 1]);
+        BezierApproxPoint eSplit = getSplitTangent(points, pointIndices, tangents, maxDistIdx);
         if (normalizePoint(&eSplit) != BEZIER_APPROX_OK) {
             result = BEZIER_APPROX_ARGUMENTS_ERROR;
             goto cleanup;
         }
 
-        result = bezierApproxByOneCurveByInitVectors(
+        assert(controlsStackSize + 1 <= controlsStackCapacity);
+        result = fitEntry(
             points,
-            maxDistIdx,
-            entry.lastIdx,
+            pointIndices,
+            tDist,
             eSplit,
             entry.e2,
-            tDist,
-            &controls
+            maxDistIdx,
+            entry.lastIdx,
+            &controlsStack[controlsStackSize]
         );
         if (result != BEZIER_APPROX_OK) {
             goto cleanup;
         }
-
-        assert(controlsStackSize + 1 <= controlsStackCapacity);
-        controlsStack[controlsStackSize].controls = controls;
-        controlsStack[controlsStackSize].e1 = eSplit;
-        controlsStack[controlsStackSize].e2 = entry.e2;
-        controlsStack[controlsStackSize].fistIdx = maxDistIdx;
-        controlsStack[controlsStackSize].lastIdx = entry.lastIdx;
         ++controlsStackSize;
 
         BezierApproxPoint eSplitInv = eSplit;
         eSplitInv.x = -eSplitInv.x;
         eSplitInv.y = -eSplitInv.y;
 
-        result = bezierApproxByOneCurveByInitVectors(
+        assert(controlsStackSize + 1 <= controlsStackCapacity);
+        result = fitEntry(
             points,
-            entry.fistIdx,
-            maxDistIdx,
+            pointIndices,
+            tDist,
             entry.e1,
             eSplitInv,
-            tDist,
-            &controls
+            entry.fistIdx,
+            maxDistIdx,
+            &controlsStack[controlsStackSize]
         );
         if (result != BEZIER_APPROX_OK) {
             goto cleanup;
         }
-
-        assert(controlsStackSize + 1 <= controlsStackCapacity);
-        controlsStack[controlsStackSize].controls = controls;
-        controlsStack[controlsStackSize].e1 = entry.e1;
-        controlsStack[controlsStackSize].e2 = eSplitInv;
-        controlsStack[controlsStackSize].fistIdx = entry.fistIdx;
-        controlsStack[controlsStackSize].lastIdx = maxDistIdx;
         ++controlsStackSize;
     }
 
-    if (controlsAnsSize > *controlsBufferSize) {
-        result = BEZIER_APPROX_BUFFER_TOO_SMALL;
-        *controlsBufferSize = controlsAnsSize;
-        goto cleanup;
+    result = controlsStackSize > 0 ? BEZIER_APPROX_INTERRUPTED : BEZIER_APPROX_OK;
+
+    // Unfinished entries are still valid curves, the top of the stack is the
+    // leftmost one.
+    while (controlsStackSize > 0) {
+        --controlsStackSize;
+        const BezierControlsStackEntry* entry = &controlsStack[controlsStackSize];
+        assert(*controlsAnsSize + 1 <= pointsSize - 1);
+        controlsAns[*controlsAnsSize] = entry->controls;
+        if (splitsAns) {
+            splitsAns[*controlsAnsSize] = entry->fistIdx;
+        }
+        ++*controlsAnsSize;
+        if (maxError && entry->maxDist > *maxError) {
+            *maxError = entry->maxDist;
+        }
     }
 
-    memcpy(controlsBuffer, controlsAns, controlsAnsSize * sizeof(BezierApproxCurve3Controls));
-    *controlsBufferSize = controlsAnsSize;
-    result = BEZIER_APPROX_OK;
+    if (splitsAns) {
+        splitsAns[*controlsAnsSize] = pointsSize - 1;
+    }
+
+    if (result == BEZIER_APPROX_OK && seedsSize > 0) {
+        assert(splitsAns);
+        result = mergeSeededSplits(
+            points,
+            pointIndices,
+            tangents,
+            pointsSize,
+            tDist,
+            e1,
+            e2,
+            precision,
+            seeds,
+            seedsSize,
+            controlsAns,
+            splitsAns,
+            controlsAnsSize,
+            maxError
+        );
+    }
 
 cleanup:
-    if (controlsStack) {
+    if (tValues) {
+        free(tValues);
+        tValues = NULL;
+    }
+    if (controlsStack && controlsStack != controlsStackBuffer) {
         free(controlsStack);
         controlsStack = NULL;
     }
-    if (tDist) {
-        free(tDist);
-        tDist = NULL;
-    }
-    if (controlsAns) {
-        free(controlsAns);
-        controlsAns = NULL;
-    }
     return result;
 }
 
-int bezierApproxByOneCurve(
-    const BezierApproxPoint points[],
-    int firstPointIndex,
-    int lastPointIndex,
+static inline void fillOnePointControls(
+    const BezierApproxPoint point,
     BezierApproxCurve3Controls* controls
 ) {
-    int result = BEZIER_APPROX_FAILED;
-    double* tDist = NULL;
+    controls->P0 = point;
+    controls->P1 = point;
+    controls->P2 = point;
+    controls->P3 = point;
+}
 
-    if (firstPointIndex + 1 > lastPointIndex) {
-        result = BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
-        goto cleanup;
+// Mean and scatter of the points in the least squares window, updated as
+// the window slides instead of being summed again for every point.
+typedef struct _BezierApproxWindowMoments {
+    int count;
+    double meanX;
+    double meanY;
+    double sxx;
+    double sxy;
+    double syy;
+} BezierApproxWindowMoments;
+
+static inline void addWindowPoint(
+    BezierApproxWindowMoments* moments,
+    const BezierApproxPoint point
+) {
+    ++moments->count;
+    double dx = point.x - moments->meanX;
+    double dy = point.y - moments->meanY;
+    moments->meanX += dx / moments->count;
+    moments->meanY += dy / moments->count;
+    moments->sxx += dx * (point.x - moments->meanX);
+    moments->sxy += dx * (point.y - moments->meanY);
+    moments->syy += dy * (point.y - moments->meanY);
+}
+
+static inline void removeWindowPoint(
+    BezierApproxWindowMoments* moments,
+    const BezierApproxPoint point
+) {
+    --moments->count;
+    double dx = point.x - moments->meanX;
+    double dy = point.y - moments->meanY;
+    moments->meanX -= dx / moments->count;
+    moments->meanY -= dy / moments->count;
+    moments->sxx -= dx * (point.x - moments->meanX);
+    moments->sxy -= dx * (point.y - moments->meanY);
+    moments->syy -= dy * (point.y - moments->meanY);
+}
+
+static inline BezierApproxPoint getLeastSquaresTangent(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const BezierApproxWindowMoments* moments,
+    int firstIdx,
+    int lastIdx
+) {
+    // Principal axis of the window, the eigenvector of the larger eigenvalue
+    // of the scatter matrix. Of its two forms the longer one is taken, it is
+    // zero only if the scatter is isotropic.
+    double halfDiff = 0.5 * (moments->sxx - moments->syy);
+    double root = sqrt(halfDiff * halfDiff + moments->sxy * moments->sxy);
+    BezierApproxPoint tangent;
+    if (halfDiff >= 0.0) {
+        tangent.x = halfDiff + root;
+        tangent.y = moments->sxy;
+    }
+    else {
+        tangent.x = moments->sxy;
+        tangent.y = root - halfDiff;
+    }
+    if (tangent.x == 0.0 && tangent.y == 0.0) {
+        tangent.x = 1.0;
     }
 
-    BezierApproxPoint e1 = substructPoint(points[firstPointIndex + 1], points[firstPointIndex]);
-    if (normalizePoint(&e1) != BEZIER_APPROX_OK) {
-        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+    // Oriented along the walking direction.
+    BezierApproxPoint chord = substructPoint(
+        getPoint(points, pointIndices, lastIdx),
+        getPoint(points, pointIndices, firstIdx)
+    );
+    if (tangent.x * chord.x + tangent.y * chord.y < 0.0) {
+        tangent.x = -tangent.x;
+        tangent.y = -tangent.y;
+    }
+    return tangent;
+}
+
+static inline BezierApproxPoint getArcWeightedTangent(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    const double tDist[],
+    int idx,
+    int firstIdx,
+    int lastIdx
+) {
+    // Every span is weighted by its length and by a triangular kernel over the
+    // arc length distance from the point.
+    double radius = fmax(tDist[lastIdx] - tDist[idx], tDist[idx] - tDist[firstIdx]);
+    radius = radius * (1.0 + EPS_ZERO) + EPS_ZERO;
+
+    BezierApproxPoint tangent = { 0.0, 0.0 };
+    for (int j = firstIdx; j < lastIdx; ++j) {
+        double mid = 0.5 * (tDist[j] + tDist[j + 1]);
+        double weight = 1.0 - fabs(mid - tDist[idx]) / radius;
+        BezierApproxPoint span = substructPoint(
+            getPoint(points, pointIndices, j + 1),
+            getPoint(points, pointIndices, j)
+        );
+        tangent.x += weight * span.x;
+        tangent.y += weight * span.y;
+    }
+    return tangent;
+}
+
+// Estimates a unit tangent for every point once, so splits only look it up.
+// The estimator and the window are validated by the caller.
+static int initTangents(
+    const BezierApproxPoint points[],
+    const int pointIndices[],
+    int pointsSize,
+    const double tDist[],
+    int tangentEstimator,
+    int tangentWindow,
+    BezierApproxPoint** tangentsAns
+) {
+    BezierApproxPoint* tangents = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    if (!tangents) {
+        return BEZIER_APPROX_FAILED;
+    }
+
+    // A wider window covers the same points, clamping it also keeps the
+    // bounds below from overflowing.
+    if (tangentWindow > pointsSize - 1) {
+        tangentWindow = pointsSize - 1;
+    }
+
+    BezierApproxWindowMoments moments = { 0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    int windowFirstIdx = 0;
+    int windowLastIdx = -1;
+    for (int i = 0; i < pointsSize; ++i) {
+        const int firstIdx = i > tangentWindow ? i - tangentWindow : 0;
+        const int lastIdx = pointsSize - 1 - i > tangentWindow ? i + tangentWindow : pointsSize - 1;
+        if (tangentEstimator == BEZIER_APPROX_TANGENT_LEAST_SQUARES) {
+            while (windowLastIdx < lastIdx) {
+                addWindowPoint(&moments, getPoint(points, pointIndices, ++windowLastIdx));
+            }
+            while (windowFirstIdx < firstIdx) {
+                removeWindowPoint(&moments, getPoint(points, pointIndices, windowFirstIdx++));
+            }
+            tangents[i] = getLeastSquaresTangent(points, pointIndices, &moments, firstIdx, lastIdx);
+        }
+        else {
+            tangents[i] = getArcWeightedTangent(points, pointIndices, tDist, i, firstIdx, lastIdx);
+        }
+        if (normalizePoint(&tangents[i]) != BEZIER_APPROX_OK) {
+            free(tangents);
+            return BEZIER_APPROX_ARGUMENTS_ERROR;
+        }
+    }
+    *tangentsAns = tangents;
+    return BEZIER_APPROX_OK;
+}
+
+static inline int getSeedIndices(
+    const double tDist[],
+    int pointsSize,
+    const double seedFractions[],
+    int seedFractionsSize,
+    int* seeds
+) {
+    int seedsSize = 0;
+    int idx = 1;
+    for (int i = 0; i < seedFractionsSize; ++i) {
+        const double target = seedFractions[i] * tDist[pointsSize - 1];
+        while (idx < pointsSize - 1 && tDist[idx] < target) {
+            ++idx;
+        }
+        int seed = idx;
+        if (seed > 1 && target - tDist[seed - 1] < tDist[seed] - target) {
+            --seed;
+        }
+        if (seed >= pointsSize - 1 || (seedsSize > 0 && seed <= seeds[seedsSize - 1])) {
+            continue;
+        }
+        seeds[seedsSize] = seed;
+        ++seedsSize;
+    }
+    return seedsSize;
+}
+
+static int approxFull(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    const BezierApproxOptions* options
+) {
+    int result = BEZIER_APPROX_FAILED;
+    double* tDist = NULL;
+    const int* pointIndices = NULL;
+    BezierApproxPoint* tangents = NULL;
+
+    int controlsAnsCapacity = 0;
+    int controlsAnsSize = 0;
+    BezierApproxCurve3Controls* controlsAns = NULL;
+    int* splitsAns = NULL;
+
+    int seedsSize = 0;
+    int* seeds = NULL;
+
+    if (pointsSize < 1) {
+        result = BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
         goto cleanup;
     }
 
-    BezierApproxPoint e2 = substructPoint(points[lastPointIndex - 1], points[lastPointIndex]);
-    if (normalizePoint(&e2) != BEZIER_APPROX_OK) {
-        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+    // Sanitizing computes the arc lengths in the same pass, the rest of the
+    // fit then addresses the kept points through pointIndices.
+    if (options->keptIndicesBuffer) {
+        tDist = initTdistSanitized(points, pointsSize, options->keptIndicesBuffer, options->keptIndicesSize);
+        if (!tDist) {
+            goto cleanup;
+        }
+        pointIndices = options->keptIndicesBuffer;
+        pointsSize = *options->keptIndicesSize;
+        if (pointsSize < 1) {
+            result = BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
+            goto cleanup;
+        }
+    }
+    controlsAnsCapacity = pointsSize - 1;
+
+    if (pointsSize == 1) {
+        if (*controlsBufferSize < 1) {
+            result = BEZIER_APPROX_BUFFER_TOO_SMALL;
+            *controlsBufferSize = 1;
+            goto cleanup;
+        }
+        *controlsBufferSize = 1;
+        fillOnePointControls(getPoint(points, pointIndices, 0), &controlsBuffer[0]);
+        if (options->splitIndicesBuffer) {
+            options->splitIndicesBuffer[0] = 0;
+            options->splitIndicesBuffer[1] = 0;
+        }
+        if (options->maxError) {
+            *options->maxError = 0.0;
+        }
+        result = BEZIER_APPROX_OK;
         goto cleanup;
     }
 
-    int tSize = lastPointIndex - firstPointIndex + 1;
-    tDist = initTdist(points, tSize);
+    // The scratch buffers are reserved for pointsSize by the caller.
+    controlsAns = options->scratch ? options->scratch->controlsBuffer : (BezierApproxCurve3Controls*)malloc(
+        sizeof(BezierApproxCurve3Controls) * controlsAnsCapacity
+    );
+    if (!controlsAns) {
+        goto cleanup;
+    }
+
+    if (options->splitIndicesBuffer || options->splitFractionsBuffer || options->seedFractionsSize > 0) {
+        splitsAns = (int*)malloc(sizeof(int) * (controlsAnsCapacity + 1));
+        if (!splitsAns) {
+            goto cleanup;
+        }
+    }
+
     if (!tDist) {
+        tDist = initTdist(points, pointsSize, options->scratch ? options->scratch->tDist : NULL);
+        if (!tDist) {
+            goto cleanup;
+        }
+    }
+
+    if (options->tangentEstimator != BEZIER_APPROX_TANGENT_CENTRAL) {
+        result = initTangents(
+            points,
+            pointIndices,
+            pointsSize,
+            tDist,
+            options->tangentEstimator,
+            options->tangentWindow,
+            &tangents
+        );
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+    }
+
+    BezierApproxPoint e1;
+    BezierApproxPoint e2;
+    result = getBoundaryTangents(points, pointIndices, tangents, pointsSize, 0, pointsSize - 1, &e1, &e2);
+    if (result != BEZIER_APPROX_OK) {
         goto cleanup;
     }
+    result = BEZIER_APPROX_FAILED;
 
-    result = bezierApproxByOneCurveByInitVectors(
+    if (options->seedFractionsSize > 0) {
+        seeds = (int*)malloc(sizeof(int) * options->seedFractionsSize);
+        if (!seeds) {
+            goto cleanup;
+        }
+        seedsSize = getSeedIndices(
+            tDist,
+            pointsSize,
+            options->seedFractions,
+            options->seedFractionsSize,
+            seeds
+        );
+    }
+
+    result = approxRange(
         points,
-        firstPointIndex,
-        lastPointIndex,
+        pointIndices,
+        tangents,
+        pointsSize,
+        tDist,
+        options->scratch ? options->scratch->controlsStack : NULL,
         e1,
         e2,
+        precision,
+        options->budget,
+        options->orthogonal ? options->refineIterations : CHORD_LENGTH_METRIC,
+        seeds,
+        seedsSize,
+        controlsAns,
+        splitsAns,
+        &controlsAnsSize,
+        options->maxError
+    );
+    if (result != BEZIER_APPROX_OK && result != BEZIER_APPROX_INTERRUPTED) {
+        goto cleanup;
+    }
+
+    if (controlsAnsSize > *controlsBufferSize) {
+        result = BEZIER_APPROX_BUFFER_TOO_SMALL;
+        *controlsBufferSize = controlsAnsSize;
+        goto cleanup;
+    }
+
+    if (controlsBuffer != controlsAns) {
+        memcpy(controlsBuffer, controlsAns, controlsAnsSize * sizeof(BezierApproxCurve3Controls));
+    }
+    if (options->splitIndicesBuffer) {
+        memcpy(options->splitIndicesBuffer, splitsAns, (controlsAnsSize + 1) * sizeof(int));
+    }
+    if (options->splitFractionsBuffer) {
+        for (int i = 1; i < controlsAnsSize; ++i) {
+            options->splitFractionsBuffer[i - 1] = tDist[splitsAns[i]] / tDist[pointsSize - 1];
+        }
+    }
+    *controlsBufferSize = controlsAnsSize;
+
+cleanup:
+    if (seeds) {
+        free(seeds);
+        seeds = NULL;
+    }
+    if (tangents) {
+        free(tangents);
+        tangents = NULL;
+    }
+    if (tDist && !(options->scratch && tDist == options->scratch->tDist)) {
+        free(tDist);
+        tDist = NULL;
+    }
+    if (splitsAns) {
+        free(splitsAns);
+        splitsAns = NULL;
+    }
+    if (controlsAns && !options->scratch) {
+        free(controlsAns);
+        controlsAns = NULL;
+    }
+    return result;
+}
+
+int bezierApproxWithSplits(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* splitIndicesBuffer
+) {
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.splitIndicesBuffer = splitIndicesBuffer;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApprox(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApproxScratchReserve(
+    BezierApproxScratch* scratch,
+    int pointsSize
+) {
+    if (pointsSize <= scratch->capacity) {
+        return BEZIER_APPROX_OK;
+    }
+
+    // Each buffer keeps its old size if a later one fails to grow, the
+    // capacity is raised only once all of them are large enough.
+    double* tDist = (double*)realloc(scratch->tDist, sizeof(double) * pointsSize);
+    if (!tDist) {
+        return BEZIER_APPROX_FAILED;
+    }
+    scratch->tDist = tDist;
+
+    BezierControlsStackEntry* controlsStack = (BezierControlsStackEntry*)realloc(
+        scratch->controlsStack,
+        sizeof(BezierControlsStackEntry) * pointsSize
+    );
+    if (!controlsStack) {
+        return BEZIER_APPROX_FAILED;
+    }
+    scratch->controlsStack = controlsStack;
+
+    BezierApproxCurve3Controls* controlsBuffer = (BezierApproxCurve3Controls*)realloc(
+        scratch->controlsBuffer,
+        sizeof(BezierApproxCurve3Controls) * pointsSize
+    );
+    if (!controlsBuffer) {
+        return BEZIER_APPROX_FAILED;
+    }
+    scratch->controlsBuffer = controlsBuffer;
+
+    scratch->capacity = pointsSize;
+    return BEZIER_APPROX_OK;
+}
+
+void bezierApproxScratchFree(
+    BezierApproxScratch* scratch
+) {
+    free(scratch->tDist);
+    free(scratch->controlsStack);
+    free(scratch->controlsBuffer);
+    memset(scratch, 0, sizeof(BezierApproxScratch));
+}
+
+int bezierApproxWithScratch(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxScratch* scratch,
+    int* controlsSize
+) {
+    int result = bezierApproxScratchReserve(scratch, pointsSize > 1 ? pointsSize : 1);
+    if (result != BEZIER_APPROX_OK) {
+        return result;
+    }
+    *controlsSize = scratch->capacity;
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.scratch = scratch;
+    return approxFull(points, pointsSize, precision, scratch->controlsBuffer, controlsSize, &options);
+}
+
+int bezierApproxWithBudget(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    double timeBudget,
+    BezierApproxCancelCallback isCancelled,
+    void* userData,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* maxError
+) {
+    BezierApproxBudget budget;
+    initBudget(timeBudget, isCancelled, userData, &budget);
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.budget = &budget;
+    options.maxError = maxError;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApproxWarmStart(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    const double prevSplitFractions[],
+    int prevSplitFractionsSize,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* splitFractionsBuffer
+) {
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.seedFractions = prevSplitFractions;
+    options.seedFractionsSize = prevSplitFractionsSize;
+    options.splitFractionsBuffer = splitFractionsBuffer;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApproxWithTangents(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int tangentEstimator,
+    int tangentWindow,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    if (tangentEstimator != BEZIER_APPROX_TANGENT_CENTRAL &&
+        (tangentWindow < 1 ||
+        (tangentEstimator != BEZIER_APPROX_TANGENT_LEAST_SQUARES &&
+        tangentEstimator != BEZIER_APPROX_TANGENT_ARC_WEIGHTED))) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.tangentEstimator = tangentEstimator;
+    options.tangentWindow = tangentWindow;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApproxOrthogonal(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int refineIterations,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    if (refineIterations < 0) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.orthogonal = 1;
+    options.refineIterations = refineIterations;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+int bezierApproxSanitized(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* keptIndicesBuffer,
+    int* keptIndicesSize
+) {
+    // approxFull takes a NULL buffer as a request not to sanitize.
+    if (!keptIndicesBuffer || !keptIndicesSize) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    BezierApproxOptions options;
+    memset(&options, 0, sizeof(options));
+    options.keptIndicesBuffer = keptIndicesBuffer;
+    options.keptIndicesSize = keptIndicesSize;
+    return approxFull(points, pointsSize, precision, controlsBuffer, controlsBufferSize, &options);
+}
+
+static inline void heapPush(
+    BezierControlsStackEntry* heap,
+    int* heapSize,
+    const BezierControlsStackEntry* heapEntry
+) {
+    int idx = *heapSize;
+    ++*heapSize;
+    while (idx > 0) {
+        int parent = (idx - 1) / 2;
+        if (heap[parent].maxDist >= heapEntry->maxDist) {
+            break;
+        }
+        heap[idx] = heap[parent];
+        idx = parent;
+    }
+    heap[idx] = *heapEntry;
+}
+
+static inline BezierControlsStackEntry heapPop(
+    BezierControlsStackEntry* heap,
+    int* heapSize
+) {
+    BezierControlsStackEntry top = heap[0];
+    --*heapSize;
+    BezierControlsStackEntry last = heap[*heapSize];
+    int idx = 0;
+    for (;;) {
+        int child = 2 * idx + 1;
+        if (child >= *heapSize) {
+            break;
+        }
+        if (child + 1 < *heapSize && heap[child + 1].maxDist > heap[child].maxDist) {
+            ++child;
+        }
+        if (last.maxDist >= heap[child].maxDist) {
+            break;
+        }
+        heap[idx] = heap[child];
+        idx = child;
+    }
+    if (*heapSize > 0) {
+        heap[idx] = last;
+    }
+    return top;
+}
+
+static int compareHeapEntries(const void* a, const void* b) {
+    const BezierControlsStackEntry* entryA = (const BezierControlsStackEntry*)a;
+    const BezierControlsStackEntry* entryB = (const BezierControlsStackEntry*)b;
+    return entryA->fistIdx - entryB->fistIdx;
+}
+
+int bezierApproxByCurvesCount(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    int maxCurvesCount,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    double* maxError
+) {
+    int result = BEZIER_APPROX_FAILED;
+    double* tDist = NULL;
+
+    int heapSize = 0;
+    BezierControlsStackEntry* heap = NULL;
+
+    if (maxCurvesCount < 1) {
+        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+        goto cleanup;
+    }
+    if (pointsSize < 2) {
+        result = bezierApprox(points, pointsSize, precision, controlsBuffer, controlsBufferSize);
+        if (result == BEZIER_APPROX_OK && maxError) {
+            *maxError = 0.0;
+        }
+        goto cleanup;
+    }
+    if (maxCurvesCount > pointsSize - 1) {
+        maxCurvesCount = pointsSize - 1;
+    }
+
+    BezierApproxPoint e1;
+    BezierApproxPoint e2;
+    result = getBoundaryTangents(points, NULL, NULL, pointsSize, 0, pointsSize - 1, &e1, &e2);
+    if (result != BEZIER_APPROX_OK) {
+        goto cleanup;
+    }
+    result = BEZIER_APPROX_FAILED;
+
+    heap = (BezierControlsStackEntry*)malloc(
+        sizeof(BezierControlsStackEntry) * (maxCurvesCount + 1)
+    );
+    if (!heap) {
+        goto cleanup;
+    }
+
+    tDist = initTdist(points, pointsSize, NULL);
+    if (!tDist) {
+        goto cleanup;
+    }
+
+    BezierControlsStackEntry heapEntry;
+    result = fitEntry(points, NULL, tDist, e1, e2, 0, pointsSize - 1, &heapEntry);
+    if (result != BEZIER_APPROX_OK) {
+        goto cleanup;
+    }
+    heapPush(heap, &heapSize, &heapEntry);
+
+    // The worst curve is always split first, so the error drops as fast as
+    // possible while the curves count grows.
+    while (heapSize < maxCurvesCount && heap[0].maxDist > precision) {
+        const int maxDistIdx = heap[0].maxDistIdx;
+        if (maxDistIdx <= heap[0].fistIdx || maxDistIdx >= heap[0].lastIdx) {
+            break;
+        }
+        BezierControlsStackEntry entry = heapPop(heap, &heapSize);
+
+        BezierApproxPoint eSplit = getSplitTangent(points, NULL, NULL, maxDistIdx);
+        if (normalizePoint(&eSplit) != BEZIER_APPROX_OK) {
+            result = BEZIER_APPROX_ARGUMENTS_ERROR;
+            goto cleanup;
+        }
+        BezierApproxPoint eSplitInv = eSplit;
+        eSplitInv.x = -eSplitInv.x;
+        eSplitInv.y = -eSplitInv.y;
+
+        result = fitEntry(points, NULL, tDist, entry.e1, eSplitInv, entry.fistIdx, maxDistIdx, &heapEntry);
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+        heapPush(heap, &heapSize, &heapEntry);
+
+        result = fitEntry(points, NULL, tDist, eSplit, entry.e2, maxDistIdx, entry.lastIdx, &heapEntry);
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+        heapPush(heap, &heapSize, &heapEntry);
+    }
+
+    if (heapSize > *controlsBufferSize) {
+        result = BEZIER_APPROX_BUFFER_TOO_SMALL;
+        *controlsBufferSize = heapSize;
+        goto cleanup;
+    }
+
+    if (maxError) {
+        *maxError = heap[0].maxDist;
+    }
+    qsort(heap, heapSize, sizeof(BezierControlsStackEntry), compareHeapEntries);
+    for (int i = 0; i < heapSize; ++i) {
+        controlsBuffer[i] = heap[i].controls;
+    }
+    *controlsBufferSize = heapSize;
+    result = BEZIER_APPROX_OK;
+
+cleanup:
+    if (tDist) {
+        free(tDist);
+        tDist = NULL;
+    }
+    if (heap) {
+        free(heap);
+        heap = NULL;
+    }
+    return result;
+}
+
+int bezierApproxRefit(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    const BezierApproxCurve3Controls prevControls[],
+    const int prevSplitIndices[],
+    int prevControlsSize,
+    int editFirstIndex,
+    int editRemovedCount,
+    int editInsertedCount,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize,
+    int* splitIndicesBuffer
+) {
+    int result = BEZIER_APPROX_FAILED;
+    double* tDist = NULL;
+
+    int regionAnsSize = 0;
+    BezierApproxCurve3Controls* regionAns = NULL;
+    int* regionSplits = NULL;
+
+    if (prevControlsSize < 1 || editFirstIndex < 0 || editRemovedCount < 0 || editInsertedCount < 0) {
+        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+        goto cleanup;
+    }
+
+    const int prevPointsSize = prevSplitIndices[prevControlsSize] + 1;
+    const int delta = editInsertedCount - editRemovedCount;
+    if (prevPointsSize + delta != pointsSize || editFirstIndex + editRemovedCount > prevPointsSize) {
+        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+        goto cleanup;
+    }
+
+    // A previous curve can be kept only if its points and the neighbours used
+    // for its end tangents are all outside of the edited range.
+    int firstAffected = 0;
+    while (firstAffected < prevControlsSize - 1 &&
+        prevSplitIndices[firstAffected + 1] <= editFirstIndex - 2) {
+        ++firstAffected;
+    }
+    int lastAffected = prevControlsSize - 1;
+    while (lastAffected > 0 &&
+        prevSplitIndices[lastAffected] >= editFirstIndex + editRemovedCount + 1) {
+        --lastAffected;
+    }
+    if (firstAffected > 0) {
+        --firstAffected;
+    }
+    if (lastAffected < prevControlsSize - 1) {
+        ++lastAffected;
+    }
+
+    const int regionFirstIdx = prevSplitIndices[firstAffected];
+    const int regionLastIdx = prevSplitIndices[lastAffected + 1] + delta;
+    const int regionSize = regionLastIdx - regionFirstIdx + 1;
+    if (regionSize < 2) {
+        result = bezierApproxWithSplits(
+            points,
+            pointsSize,
+            precision,
+            controlsBuffer,
+            controlsBufferSize,
+            splitIndicesBuffer
+        );
+        goto cleanup;
+    }
+
+    BezierApproxPoint e1;
+    BezierApproxPoint e2;
+    result = getBoundaryTangents(points, NULL, NULL, pointsSize, regionFirstIdx, regionLastIdx, &e1, &e2);
+    if (result != BEZIER_APPROX_OK) {
+        goto cleanup;
+    }
+    result = BEZIER_APPROX_FAILED;
+
+    regionAns = (BezierApproxCurve3Controls*)malloc(
+        sizeof(BezierApproxCurve3Controls) * (regionSize - 1)
+    );
+    if (!regionAns) {
+        goto cleanup;
+    }
+
+    regionSplits = (int*)malloc(sizeof(int) * regionSize);
+    if (!regionSplits) {
+        goto cleanup;
+    }
+
+    tDist = initTdist(points + regionFirstIdx, regionSize, NULL);
+    if (!tDist) {
+        goto cleanup;
+    }
+
+    result = approxRange(
+        points + regionFirstIdx,
+        NULL,
+        NULL,
+        regionSize,
         tDist,
-        controls
+        NULL,
+        e1,
+        e2,
+        precision,
+        NULL,
+        CHORD_LENGTH_METRIC,
+        NULL,
+        0,
+        regionAns,
+        regionSplits,
+        &regionAnsSize,
+        NULL
+    );
+    if (result != BEZIER_APPROX_OK) {
+        goto cleanup;
+    }
+
+    const int suffixSize = prevControlsSize - lastAffected - 1;
+    const int controlsAnsSize = firstAffected + regionAnsSize + suffixSize;
+    if (controlsAnsSize > *controlsBufferSize) {
+        result = BEZIER_APPROX_BUFFER_TOO_SMALL;
+        *controlsBufferSize = controlsAnsSize;
+        goto cleanup;
+    }
+
+    // The buffers are allowed to alias the previous fit, so the suffix is moved
+    // before the refitted region overwrites it.
+    memmove(
+        controlsBuffer + firstAffected + regionAnsSize,
+        prevControls + lastAffected + 1,
+        suffixSize * sizeof(BezierApproxCurve3Controls)
+    );
+    if (controlsBuffer != prevControls) {
+        memcpy(controlsBuffer, prevControls, firstAffected * sizeof(BezierApproxCurve3Controls));
+    }
+    memcpy(
+        controlsBuffer + firstAffected,
+        regionAns,
+        regionAnsSize * sizeof(BezierApproxCurve3Controls)
     );
 
+    if (splitIndicesBuffer) {
+        int* suffixSplits = splitIndicesBuffer + firstAffected + regionAnsSize;
+        memmove(
+            suffixSplits,
+            prevSplitIndices + lastAffected + 1,
+            (suffixSize + 1) * sizeof(int)
+        );
+        for (int i = 0; i <= suffixSize; ++i) {
+            suffixSplits[i] += delta;
+        }
+        if (splitIndicesBuffer != prevSplitIndices) {
+            memcpy(splitIndicesBuffer, prevSplitIndices, firstAffected * sizeof(int));
+        }
+        for (int i = 0; i < regionAnsSize; ++i) {
+            splitIndicesBuffer[firstAffected + i] = regionSplits[i] + regionFirstIdx;
+        }
+    }
+
+    *controlsBufferSize = controlsAnsSize;
+    result = BEZIER_APPROX_OK;
+
 cleanup:
     if (tDist) {
         free(tDist);
         tDist = NULL;
     }
+    if (regionSplits) {
+        free(regionSplits);
+        regionSplits = NULL;
+    }
+    if (regionAns) {
+        free(regionAns);
+        regionAns = NULL;
+    }
     return result;
 }
 
+int bezierApproxByOneCurve(
+    const BezierApproxPoint points[],
+    int firstPointIndex,
+    int lastPointIndex,
+    BezierApproxCurve3Controls* controls
+) {
+    return bezierApproxInlineByOneCurve(points, firstPointIndex, lastPointIndex, controls);
+}
+
 BezierApproxPoint bezierApproxGetCurveValue(
     const BezierApproxCurve3Controls controls,
     double t
 ) {
-    double x = 
-        bValue(0, t) * controls.P0.x +
-        bValue(1, t) * controls.P1.x +
-        bValue(2, t) * controls.P2.x +
-        bValue(3, t) * controls.P3.x;
-
-    double y =
-        bValue(0, t) * controls.P0.y +
-        bValue(1, t) * controls.P1.y +
-        bValue(2, t) * controls.P2.y +
-        bValue(3, t) * controls.P3.y;
-
-    BezierApproxPoint result;
-    result.x = x;
-    result.y = y;
-    return result;
+    return bezierApproxInlineGetCurveValue(controls, t);
+}
+
+#if BEZIERAPPROXLIB_FIT_STATS
+void bezierApproxGetFitStats(
+    BezierApproxFitStats* stats
+) {
+    *stats = fitStats;
 }
+#endif
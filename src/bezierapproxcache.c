@@ -0,0 +1,668 @@
+#include "bezierapproxcache.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_SHARDS_COUNT 16
+#define CACHE_INITIAL_BUCKETS_COUNT 64
+#define CACHE_FILE_MAGIC 0x43415a42u
+#define CACHE_FILE_VERSION 2u
+
+typedef struct _BezierCacheKey {
+    uint64_t hash[2];
+    double precision;
+    int pointsSize;
+    int tangentEstimator;
+    int tangentWindow;
+} BezierCacheKey;
+
+typedef struct _BezierCacheEntry {
+    BezierCacheKey key;
+    struct _BezierCacheEntry* chainNext;
+    struct _BezierCacheEntry* lruPrev;
+    struct _BezierCacheEntry* lruNext;
+    int controlsSize;
+    BezierApproxCurve3Controls controls[];
+} BezierCacheEntry;
+
+// Every shard is a hash table with its own lock and LRU list, so threads
+// only contend when their keys land in the same shard.
+typedef struct _BezierCacheShard {
+    mtx_t lock;
+    BezierCacheEntry** buckets;
+    size_t bucketsMask;
+    BezierCacheEntry* lruHead;
+    BezierCacheEntry* lruTail;
+    int entriesCount;
+    size_t bytesUsed;
+} BezierCacheShard;
+
+struct _BezierApproxCache {
+    BezierCacheShard shards[CACHE_SHARDS_COUNT];
+    int shardsCount;
+    size_t shardCapacity;
+    char* path;
+    // Keys the point hash, so colliding strokes can't be crafted offline.
+    // Loaded with the file, whose keys were hashed with it.
+    uint64_t seed[2];
+    // Makes the temporary file of every save unique.
+    atomic_uint savesCount;
+
+    atomic_ullong hits;
+    atomic_ullong misses;
+    atomic_ullong evictions;
+};
+
+typedef struct _BezierCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+    uint64_t entriesCount;
+    uint64_t seed[2];
+} BezierCacheFileHeader;
+
+// Followed by controlsSize curves.
+typedef struct _BezierCacheFileRecord {
+    BezierCacheKey key;
+    int32_t controlsSize;
+    int32_t reserved;
+} BezierCacheFileRecord;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Two independent multiply-rotate lanes over the bits of x and y, started
+// from the seed and mixed together at the end. Not cryptographic, but 128
+// bits make accidental collisions negligible, and without the seed the
+// lanes can't be run backwards to build deliberate ones.
+static inline void hashPoints(
+    const uint64_t seed[2],
+    const BezierApproxPoint points[],
+    int pointsSize,
+    uint64_t hash[2]
+) {
+    uint64_t h1 = seed[0] ^ 0x9e3779b97f4a7c15ULL;
+    uint64_t h2 = seed[1] ^ 0xc2b2ae3d27d4eb4fULL;
+    for (int i = 0; i < pointsSize; ++i) {
+        uint64_t x;
+        uint64_t y;
+        memcpy(&x, &points[i].x, sizeof(x));
+        memcpy(&y, &points[i].y, sizeof(y));
+        h1 = rotl64(h1 + x * 0xc2b2ae3d27d4eb4fULL, 31) * 0x9e3779b97f4a7c15ULL;
+        h2 = rotl64(h2 + y * 0x165667b19e3779f9ULL, 27) * 0x85ebca77c2b2ae63ULL;
+    }
+    hash[0] = mix64(h1 ^ rotl64(h2, 17) ^ (uint64_t)pointsSize);
+    hash[1] = mix64(h2 + h1 * 0x27d4eb2f165667c5ULL);
+}
+
+// Falls back to the clock and the address of the cache if the system has no
+// random source.
+static void initSeed(BezierApproxCache* cache) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    cache->seed[0] = mix64((uint64_t)ts.tv_sec ^ rotl64((uint64_t)ts.tv_nsec, 32));
+    cache->seed[1] = mix64((uint64_t)(uintptr_t)cache ^ cache->seed[0]);
+#if !defined(_WIN32)
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        uint64_t random[2];
+        if (read(fd, random, sizeof(random)) == (ssize_t)sizeof(random)) {
+            cache->seed[0] ^= random[0];
+            cache->seed[1] ^= random[1];
+        }
+        close(fd);
+    }
+#endif
+}
+
+static inline int keysEqual(const BezierCacheKey* a, const BezierCacheKey* b) {
+    return a->hash[0] == b->hash[0] &&
+        a->hash[1] == b->hash[1] &&
+        a->precision == b->precision &&
+        a->pointsSize == b->pointsSize &&
+        a->tangentEstimator == b->tangentEstimator &&
+        a->tangentWindow == b->tangentWindow;
+}
+
+static inline size_t getEntryBytes(int controlsSize) {
+    return sizeof(BezierCacheEntry) + sizeof(BezierApproxCurve3Controls) * controlsSize;
+}
+
+static inline BezierCacheShard* getShard(BezierApproxCache* cache, const BezierCacheKey* key) {
+    return &cache->shards[key->hash[0] >> 60];
+}
+
+static inline BezierCacheEntry** getBucket(BezierCacheShard* shard, const BezierCacheKey* key) {
+    return &shard->buckets[key->hash[1] & shard->bucketsMask];
+}
+
+static inline void lruUnlink(BezierCacheShard* shard, BezierCacheEntry* entry) {
+    if (entry->lruPrev) {
+        entry->lruPrev->lruNext = entry->lruNext;
+    }
+    else {
+        shard->lruHead = entry->lruNext;
+    }
+    if (entry->lruNext) {
+        entry->lruNext->lruPrev = entry->lruPrev;
+    }
+    else {
+        shard->lruTail = entry->lruPrev;
+    }
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+static inline void lruPushFront(BezierCacheShard* shard, BezierCacheEntry* entry) {
+    entry->lruPrev = NULL;
+    entry->lruNext = shard->lruHead;
+    if (shard->lruHead) {
+        shard->lruHead->lruPrev = entry;
+    }
+    else {
+        shard->lruTail = entry;
+    }
+    shard->lruHead = entry;
+}
+
+static inline BezierCacheEntry* findEntry(BezierCacheShard* shard, const BezierCacheKey* key) {
+    for (BezierCacheEntry* entry = *getBucket(shard, key); entry; entry = entry->chainNext) {
+        if (keysEqual(&entry->key, key)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void removeEntry(BezierCacheShard* shard, BezierCacheEntry* entry) {
+    BezierCacheEntry** link = getBucket(shard, &entry->key);
+    while (*link != entry) {
+        link = &(*link)->chainNext;
+    }
+    *link = entry->chainNext;
+    lruUnlink(shard, entry);
+    --shard->entriesCount;
+    shard->bytesUsed -= getEntryBytes(entry->controlsSize);
+    free(entry);
+}
+
+// Keeps the chains short. If the allocation fails the old table stays.
+static void growBuckets(BezierCacheShard* shard) {
+    const size_t bucketsCount = (shard->bucketsMask + 1) * 2;
+    BezierCacheEntry** buckets = (BezierCacheEntry**)calloc(bucketsCount, sizeof(BezierCacheEntry*));
+    if (!buckets) {
+        return;
+    }
+    for (size_t i = 0; i <= shard->bucketsMask; ++i) {
+        BezierCacheEntry* entry = shard->buckets[i];
+        while (entry) {
+            BezierCacheEntry* next = entry->chainNext;
+            BezierCacheEntry** bucket = &buckets[entry->key.hash[1] & (bucketsCount - 1)];
+            entry->chainNext = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucketsMask = bucketsCount - 1;
+}
+
+// Must be called with the shard locked. Results larger than the shard are
+// not cached.
+static void insertEntry(
+    BezierApproxCache* cache,
+    BezierCacheShard* shard,
+    const BezierCacheKey* key,
+    const BezierApproxCurve3Controls controls[],
+    int controlsSize
+) {
+    BezierCacheEntry* entry = findEntry(shard, key);
+    if (entry) {
+        lruUnlink(shard, entry);
+        lruPushFront(shard, entry);
+        return;
+    }
+
+    const size_t entryBytes = getEntryBytes(controlsSize);
+    if (entryBytes > cache->shardCapacity) {
+        return;
+    }
+    while (shard->bytesUsed + entryBytes > cache->shardCapacity) {
+        removeEntry(shard, shard->lruTail);
+        atomic_fetch_add(&cache->evictions, 1);
+    }
+
+    entry = (BezierCacheEntry*)malloc(entryBytes);
+    if (!entry) {
+        return;
+    }
+    entry->key = *key;
+    entry->controlsSize = controlsSize;
+    memcpy(entry->controls, controls, sizeof(BezierApproxCurve3Controls) * controlsSize);
+
+    BezierCacheEntry** bucket = getBucket(shard, key);
+    entry->chainNext = *bucket;
+    *bucket = entry;
+    lruPushFront(shard, entry);
+    ++shard->entriesCount;
+    shard->bytesUsed += entryBytes;
+
+    if ((size_t)shard->entriesCount > shard->bucketsMask + 1) {
+        growBuckets(shard);
+    }
+}
+
+#if defined(_WIN32)
+
+// No memory mapped files here yet: the cache starts empty and works in
+// memory, only saving fails.
+static int loadFile(BezierApproxCache* cache) {
+    (void)cache;
+    return BEZIER_APPROX_OK;
+}
+
+static int saveFile(BezierApproxCache* cache) {
+    (void)cache;
+    return BEZIER_APPROX_FAILED;
+}
+
+#else
+
+// A missing or unreadable file just leaves the cache empty.
+static int loadFile(BezierApproxCache* cache) {
+    int fd = open(cache->path, O_RDONLY);
+    if (fd < 0) {
+        return BEZIER_APPROX_OK;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(BezierCacheFileHeader)) {
+        close(fd);
+        return BEZIER_APPROX_OK;
+    }
+    const size_t fileSize = (size_t)fileStat.st_size;
+    void* data = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return BEZIER_APPROX_OK;
+    }
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    BezierCacheFileHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != CACHE_FILE_MAGIC ||
+        header.version != CACHE_FILE_VERSION ||
+        header.recordSize != sizeof(BezierCacheFileRecord)) {
+        munmap(data, fileSize);
+        return BEZIER_APPROX_OK;
+    }
+    cache->seed[0] = header.seed[0];
+    cache->seed[1] = header.seed[1];
+
+    size_t offset = sizeof(header);
+    for (uint64_t i = 0; i < header.entriesCount; ++i) {
+        BezierCacheFileRecord record;
+        if (fileSize - offset < sizeof(record)) {
+            break;
+        }
+        memcpy(&record, bytes + offset, sizeof(record));
+        offset += sizeof(record);
+
+        const size_t controlsBytes = sizeof(BezierApproxCurve3Controls) * (size_t)record.controlsSize;
+        if (record.controlsSize < 1 || fileSize - offset < controlsBytes) {
+            break;
+        }
+        BezierCacheShard* shard = getShard(cache, &record.key);
+        mtx_lock(&shard->lock);
+        insertEntry(cache, shard, &record.key, (const BezierApproxCurve3Controls*)(bytes + offset), record.controlsSize);
+        mtx_unlock(&shard->lock);
+        offset += controlsBytes;
+    }
+
+    munmap(data, fileSize);
+    atomic_store(&cache->evictions, 0);
+    return BEZIER_APPROX_OK;
+}
+
+// Serialized records of one shard, from the least recently used, so loading
+// them back restores the LRU order.
+typedef struct _BezierCacheSnapshot {
+    unsigned char* bytes;
+    size_t size;
+    uint64_t entriesCount;
+} BezierCacheSnapshot;
+
+static int snapshotShard(BezierCacheShard* shard, BezierCacheSnapshot* snapshot) {
+    int result = BEZIER_APPROX_FAILED;
+    mtx_lock(&shard->lock);
+
+    snapshot->size = 0;
+    snapshot->entriesCount = 0;
+    for (BezierCacheEntry* entry = shard->lruHead; entry; entry = entry->lruNext) {
+        snapshot->size += sizeof(BezierCacheFileRecord) + sizeof(BezierApproxCurve3Controls) * entry->controlsSize;
+        ++snapshot->entriesCount;
+    }
+    snapshot->bytes = (unsigned char*)malloc(snapshot->size > 0 ? snapshot->size : 1);
+    if (!snapshot->bytes) {
+        goto cleanup;
+    }
+
+    size_t offset = 0;
+    for (BezierCacheEntry* entry = shard->lruTail; entry; entry = entry->lruPrev) {
+        BezierCacheFileRecord record;
+        memset(&record, 0, sizeof(record));
+        record.key = entry->key;
+        record.controlsSize = entry->controlsSize;
+        memcpy(snapshot->bytes + offset, &record, sizeof(record));
+        offset += sizeof(record);
+
+        const size_t controlsBytes = sizeof(BezierApproxCurve3Controls) * entry->controlsSize;
+        memcpy(snapshot->bytes + offset, entry->controls, controlsBytes);
+        offset += controlsBytes;
+    }
+    result = BEZIER_APPROX_OK;
+
+cleanup:
+    mtx_unlock(&shard->lock);
+    return result;
+}
+
+// Every shard is copied under its own lock, then the file is written with
+// no lock held, so fits only wait for the copy of their shard.
+static int saveFile(BezierApproxCache* cache) {
+    int result = BEZIER_APPROX_FAILED;
+    BezierCacheSnapshot snapshots[CACHE_SHARDS_COUNT];
+    char* tmpPath = NULL;
+    int fd = -1;
+    void* data = MAP_FAILED;
+    size_t fileSize = sizeof(BezierCacheFileHeader);
+    uint64_t entriesCount = 0;
+
+    memset(snapshots, 0, sizeof(snapshots));
+    for (int s = 0; s < cache->shardsCount; ++s) {
+        if (snapshotShard(&cache->shards[s], &snapshots[s]) != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+        fileSize += snapshots[s].size;
+        entriesCount += snapshots[s].entriesCount;
+    }
+
+    const size_t pathSize = strlen(cache->path);
+    tmpPath = (char*)malloc(pathSize + 48);
+    if (!tmpPath) {
+        goto cleanup;
+    }
+    snprintf(tmpPath, pathSize + 48, "%s.%ld.%u.tmp", cache->path, (long)getpid(),
+        atomic_fetch_add(&cache->savesCount, 1));
+
+    fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        goto cleanup;
+    }
+    if (ftruncate(fd, (off_t)fileSize) != 0) {
+        goto cleanup;
+    }
+    data = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        goto cleanup;
+    }
+
+    unsigned char* bytes = (unsigned char*)data;
+    BezierCacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.recordSize = sizeof(BezierCacheFileRecord);
+    header.entriesCount = entriesCount;
+    header.seed[0] = cache->seed[0];
+    header.seed[1] = cache->seed[1];
+    memcpy(bytes, &header, sizeof(header));
+
+    size_t offset = sizeof(header);
+    for (int s = 0; s < cache->shardsCount; ++s) {
+        memcpy(bytes + offset, snapshots[s].bytes, snapshots[s].size);
+        offset += snapshots[s].size;
+    }
+
+    if (msync(data, fileSize, MS_SYNC) != 0) {
+        goto cleanup;
+    }
+    if (rename(tmpPath, cache->path) != 0) {
+        goto cleanup;
+    }
+    result = BEZIER_APPROX_OK;
+
+cleanup:
+    for (int s = 0; s < cache->shardsCount; ++s) {
+        free(snapshots[s].bytes);
+        snapshots[s].bytes = NULL;
+    }
+    if (data != MAP_FAILED) {
+        munmap(data, fileSize);
+        data = MAP_FAILED;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (tmpPath) {
+        if (result != BEZIER_APPROX_OK) {
+            unlink(tmpPath);
+        }
+        free(tmpPath);
+        tmpPath = NULL;
+    }
+    return result;
+}
+
+#endif
+
+static void freeCache(BezierApproxCache* cache) {
+    for (int s = 0; s < cache->shardsCount; ++s) {
+        BezierCacheShard* shard = &cache->shards[s];
+        BezierCacheEntry* entry = shard->lruHead;
+        while (entry) {
+            BezierCacheEntry* next = entry->lruNext;
+            free(entry);
+            entry = next;
+        }
+        free(shard->buckets);
+        mtx_destroy(&shard->lock);
+    }
+    free(cache->path);
+    free(cache);
+}
+
+int bezierApproxCacheCreate(
+    size_t capacityBytes,
+    const char* path,
+    BezierApproxCache** cache
+) {
+    int result = BEZIER_APPROX_FAILED;
+    BezierApproxCache* ans = NULL;
+
+    if (capacityBytes == 0 || !cache) {
+        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+        goto cleanup;
+    }
+
+    ans = (BezierApproxCache*)calloc(1, sizeof(BezierApproxCache));
+    if (!ans) {
+        goto cleanup;
+    }
+    ans->shardCapacity = capacityBytes / CACHE_SHARDS_COUNT;
+    initSeed(ans);
+    for (int s = 0; s < CACHE_SHARDS_COUNT; ++s) {
+        BezierCacheShard* shard = &ans->shards[s];
+        shard->buckets = (BezierCacheEntry**)calloc(CACHE_INITIAL_BUCKETS_COUNT, sizeof(BezierCacheEntry*));
+        if (!shard->buckets) {
+            goto cleanup;
+        }
+        if (mtx_init(&shard->lock, mtx_plain) != thrd_success) {
+            free(shard->buckets);
+            shard->buckets = NULL;
+            goto cleanup;
+        }
+        shard->bucketsMask = CACHE_INITIAL_BUCKETS_COUNT - 1;
+        ++ans->shardsCount;
+    }
+
+    if (path) {
+        const size_t pathSize = strlen(path) + 1;
+        ans->path = (char*)malloc(pathSize);
+        if (!ans->path) {
+            goto cleanup;
+        }
+        memcpy(ans->path, path, pathSize);
+        result = loadFile(ans);
+        if (result != BEZIER_APPROX_OK) {
+            goto cleanup;
+        }
+        result = BEZIER_APPROX_FAILED;
+    }
+
+    *cache = ans;
+    ans = NULL;
+    result = BEZIER_APPROX_OK;
+
+cleanup:
+    if (ans) {
+        freeCache(ans);
+        ans = NULL;
+    }
+    return result;
+}
+
+int bezierApproxCacheFit(
+    BezierApproxCache* cache,
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    int tangentEstimator,
+    int tangentWindow,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    if (!cache || pointsSize < 1) {
+        return bezierApproxWithTangents(
+            points,
+            pointsSize,
+            precision,
+            tangentEstimator,
+            tangentWindow,
+            controlsBuffer,
+            controlsBufferSize
+        );
+    }
+
+    // The central difference ignores the window, so any window hits.
+    BezierCacheKey key;
+    memset(&key, 0, sizeof(key));
+    hashPoints(cache->seed, points, pointsSize, key.hash);
+    key.precision = precision;
+    key.pointsSize = pointsSize;
+    key.tangentEstimator = tangentEstimator;
+    key.tangentWindow = tangentEstimator == BEZIER_APPROX_TANGENT_CENTRAL ? 0 : tangentWindow;
+
+    BezierCacheShard* shard = getShard(cache, &key);
+    mtx_lock(&shard->lock);
+    BezierCacheEntry* entry = findEntry(shard, &key);
+    if (entry) {
+        int result = BEZIER_APPROX_OK;
+        lruUnlink(shard, entry);
+        lruPushFront(shard, entry);
+        if (entry->controlsSize > *controlsBufferSize) {
+            result = BEZIER_APPROX_BUFFER_TOO_SMALL;
+        }
+        else {
+            memcpy(controlsBuffer, entry->controls, sizeof(BezierApproxCurve3Controls) * entry->controlsSize);
+        }
+        *controlsBufferSize = entry->controlsSize;
+        mtx_unlock(&shard->lock);
+        atomic_fetch_add(&cache->hits, 1);
+        return result;
+    }
+    mtx_unlock(&shard->lock);
+    atomic_fetch_add(&cache->misses, 1);
+
+    // Fitted without the lock, so concurrent misses of one key may fit it
+    // twice, the second insertion is dropped.
+    int result = bezierApproxWithTangents(
+        points,
+        pointsSize,
+        precision,
+        tangentEstimator,
+        tangentWindow,
+        controlsBuffer,
+        controlsBufferSize
+    );
+    if (result == BEZIER_APPROX_OK) {
+        mtx_lock(&shard->lock);
+        insertEntry(cache, shard, &key, controlsBuffer, *controlsBufferSize);
+        mtx_unlock(&shard->lock);
+    }
+    return result;
+}
+
+int bezierApproxCacheSave(
+    BezierApproxCache* cache
+) {
+    if (!cache || !cache->path) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+    return saveFile(cache);
+}
+
+void bezierApproxCacheGetStats(
+    BezierApproxCache* cache,
+    BezierApproxCacheStats* stats
+) {
+    stats->hits = atomic_load(&cache->hits);
+    stats->misses = atomic_load(&cache->misses);
+    stats->evictions = atomic_load(&cache->evictions);
+    stats->entriesCount = 0;
+    stats->bytesUsed = 0;
+    for (int s = 0; s < cache->shardsCount; ++s) {
+        BezierCacheShard* shard = &cache->shards[s];
+        mtx_lock(&shard->lock);
+        stats->entriesCount += shard->entriesCount;
+        stats->bytesUsed += shard->bytesUsed;
+        mtx_unlock(&shard->lock);
+    }
+}
+
+void bezierApproxCacheDestroy(
+    BezierApproxCache* cache
+) {
+    if (!cache) {
+        return;
+    }
+    if (cache->path) {
+        saveFile(cache);
+    }
+    freeCache(cache);
+}
@@ -0,0 +1,33 @@
+#include "bezierapprox.hpp"
+
+#include <new>
+
+int bezierApproxF(
+    const BezierApproxPointF points[],
+    int pointsSize,
+    float precision,
+    BezierApproxCurve3ControlsF* controlsBuffer,
+    int* controlsBufferSize
+) {
+    // The template fit allocates with std::vector, an exception must not
+    // cross the C interface.
+    try {
+        return bezierapprox::fit<float>(
+            points,
+            pointsSize,
+            precision,
+            controlsBuffer,
+            controlsBufferSize
+        );
+    }
+    catch (const std::bad_alloc&) {
+        return BEZIER_APPROX_FAILED;
+    }
+}
+
+BezierApproxPointF bezierApproxGetCurveValueF(
+    const BezierApproxCurve3ControlsF controls,
+    float t
+) {
+    return bezierApproxInlineGetCurveValueF(controls, t);
+}
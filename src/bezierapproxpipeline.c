@@ -0,0 +1,588 @@
+#include "bezierapproxpipeline.h"
+#include "bezierapproxprivate.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define LATENCY_BUCKETS_PER_OCTAVE 4
+#define LATENCY_BUCKETS_COUNT (64 * LATENCY_BUCKETS_PER_OCTAVE)
+
+typedef struct _BezierPipelineJob {
+    const BezierApproxPoint* points;
+    int pointsSize;
+    double precision;
+    int streamId;
+    unsigned long long sequence;
+    double submitTime;
+} BezierPipelineJob;
+
+typedef struct _BezierPipelineCell {
+    atomic_size_t sequence;
+    BezierPipelineJob job;
+} BezierPipelineCell;
+
+typedef struct _BezierPipelinePendingResult {
+    unsigned long long sequence;
+    int result;
+    BezierApproxCurve3Controls* controls;
+    int controlsSize;
+    double submitTime;
+} BezierPipelinePendingResult;
+
+typedef struct _BezierPipelineStream {
+    mtx_t lock;
+    unsigned long long nextSubmit;
+    unsigned long long nextDeliver;
+    // Set while the callback for nextDeliver runs.
+    int delivering;
+    BezierPipelinePendingResult* pending;
+    int pendingSize;
+} BezierPipelineStream;
+
+typedef struct _BezierPipelineWorker {
+    BezierApproxPipeline* pipeline;
+    thrd_t thread;
+    int started;
+    BezierApproxScratch scratch;
+} BezierPipelineWorker;
+
+struct _BezierApproxPipeline {
+    BezierPipelineCell* cells;
+    size_t cellsMask;
+    atomic_size_t enqueuePos;
+    atomic_size_t dequeuePos;
+
+    BezierPipelineStream* streams;
+    int streamsCount;
+    int pendingCapacity;
+
+    BezierPipelineWorker* workers;
+    int workersCount;
+
+    BezierApproxPipelineCallback callback;
+    void* userData;
+
+    mtx_t idleLock;
+    cnd_t idleCond;
+    atomic_int idleWorkers;
+    atomic_int stop;
+
+    mtx_t flushLock;
+    cnd_t flushCond;
+    atomic_int flushWaiters;
+
+    atomic_int queued;
+    atomic_ullong submitted;
+    atomic_ullong rejected;
+    atomic_ullong completed;
+    atomic_ullong latencySumNs;
+    atomic_ullong latencyMaxNs;
+    atomic_ullong latencyBuckets[LATENCY_BUCKETS_COUNT];
+};
+
+static inline double getTimeSeconds() {
+    struct timespec ts;
+    if (!timespec_get(&ts, TIME_UTC)) {
+        return 0.0;
+    }
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
+
+static inline int pushJob(
+    BezierApproxPipeline* pipeline,
+    const BezierPipelineJob* job
+) {
+    size_t pos = atomic_load_explicit(&pipeline->enqueuePos, memory_order_relaxed);
+    BezierPipelineCell* cell = NULL;
+    for (;;) {
+        cell = &pipeline->cells[pos & pipeline->cellsMask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                &pipeline->enqueuePos, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return BEZIER_APPROX_QUEUE_FULL;
+        }
+        else {
+            pos = atomic_load_explicit(&pipeline->enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->job = *job;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return BEZIER_APPROX_OK;
+}
+
+static inline int popJob(
+    BezierApproxPipeline* pipeline,
+    BezierPipelineJob* job
+) {
+    size_t pos = atomic_load_explicit(&pipeline->dequeuePos, memory_order_relaxed);
+    BezierPipelineCell* cell = NULL;
+    for (;;) {
+        cell = &pipeline->cells[pos & pipeline->cellsMask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                &pipeline->dequeuePos, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return 0;
+        }
+        else {
+            pos = atomic_load_explicit(&pipeline->dequeuePos, memory_order_relaxed);
+        }
+    }
+    *job = cell->job;
+    atomic_store_explicit(&cell->sequence, pos + pipeline->cellsMask + 1, memory_order_release);
+    return 1;
+}
+
+static inline void recordLatency(
+    BezierApproxPipeline* pipeline,
+    double submitTime
+) {
+    double latency = getTimeSeconds() - submitTime;
+    unsigned long long latencyNs = latency > 0.0 ? (unsigned long long)(latency * 1.0e9) : 0;
+
+    int bucket = 0;
+    if (latencyNs > 1) {
+        bucket = (int)(LATENCY_BUCKETS_PER_OCTAVE * log2((double)latencyNs));
+    }
+    if (bucket >= LATENCY_BUCKETS_COUNT) {
+        bucket = LATENCY_BUCKETS_COUNT - 1;
+    }
+    atomic_fetch_add(&pipeline->latencyBuckets[bucket], 1);
+    atomic_fetch_add(&pipeline->latencySumNs, latencyNs);
+
+    unsigned long long maxNs = atomic_load(&pipeline->latencyMaxNs);
+    while (latencyNs > maxNs &&
+        !atomic_compare_exchange_weak(&pipeline->latencyMaxNs, &maxNs, latencyNs)) {
+    }
+}
+
+static inline void deliver(
+    BezierApproxPipeline* pipeline,
+    int streamId,
+    unsigned long long sequence,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize,
+    double submitTime
+) {
+    pipeline->callback(pipeline->userData, streamId, sequence, result, controls, controlsSize);
+    recordLatency(pipeline, submitTime);
+    unsigned long long completed = atomic_fetch_add(&pipeline->completed, 1) + 1;
+
+    // A flushing thread counts as waiting before it checks the counters, so
+    // either it sees this completion or the broadcast reaches it.
+    if (atomic_load(&pipeline->flushWaiters) > 0 && completed >= atomic_load(&pipeline->submitted)) {
+        mtx_lock(&pipeline->flushLock);
+        cnd_broadcast(&pipeline->flushCond);
+        mtx_unlock(&pipeline->flushLock);
+    }
+}
+
+// Results that finish ahead of an earlier submission of the same stream are
+// parked and delivered as soon as the gap is filled. Callbacks run without
+// the stream lock. nextDeliver is advanced only after a callback returns, so
+// while one runs every later result of the stream is parked and the worker
+// that delivers also delivers them, in order and one at a time. The result
+// in the callback is already counted as delivered by Submit.
+static void completeJob(
+    BezierApproxPipeline* pipeline,
+    const BezierPipelineJob* job,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize
+) {
+    BezierPipelineStream* stream = &pipeline->streams[job->streamId];
+    mtx_lock(&stream->lock);
+
+    if (job->sequence != stream->nextDeliver) {
+        BezierPipelinePendingResult* pending = &stream->pending[stream->pendingSize];
+        pending->sequence = job->sequence;
+        pending->result = result;
+        pending->controls = NULL;
+        pending->controlsSize = 0;
+        pending->submitTime = job->submitTime;
+        if (controlsSize > 0) {
+            pending->controls = (BezierApproxCurve3Controls*)malloc(
+                sizeof(BezierApproxCurve3Controls) * controlsSize
+            );
+            if (pending->controls) {
+                memcpy(pending->controls, controls, sizeof(BezierApproxCurve3Controls) * controlsSize);
+                pending->controlsSize = controlsSize;
+            }
+            else {
+                pending->result = BEZIER_APPROX_FAILED;
+            }
+        }
+        ++stream->pendingSize;
+        mtx_unlock(&stream->lock);
+        return;
+    }
+    stream->delivering = 1;
+    mtx_unlock(&stream->lock);
+
+    deliver(pipeline, job->streamId, job->sequence, result, controls, controlsSize, job->submitTime);
+
+    mtx_lock(&stream->lock);
+    ++stream->nextDeliver;
+    stream->delivering = 0;
+
+    int found = 1;
+    while (found) {
+        found = 0;
+        for (int i = 0; i < stream->pendingSize; ++i) {
+            BezierPipelinePendingResult pending = stream->pending[i];
+            if (pending.sequence != stream->nextDeliver) {
+                continue;
+            }
+            stream->pending[i] = stream->pending[stream->pendingSize - 1];
+            --stream->pendingSize;
+            stream->delivering = 1;
+            mtx_unlock(&stream->lock);
+
+            deliver(
+                pipeline,
+                job->streamId,
+                pending.sequence,
+                pending.result,
+                pending.controls,
+                pending.controlsSize,
+                pending.submitTime
+            );
+            free(pending.controls);
+
+            mtx_lock(&stream->lock);
+            ++stream->nextDeliver;
+            stream->delivering = 0;
+            found = 1;
+            break;
+        }
+    }
+
+    mtx_unlock(&stream->lock);
+}
+
+static void processJob(
+    BezierPipelineWorker* worker,
+    const BezierPipelineJob* job
+) {
+    int controlsSize = 0;
+    int result = bezierApproxWithScratch(
+        job->points,
+        job->pointsSize,
+        job->precision,
+        &worker->scratch,
+        &controlsSize
+    );
+    if (result != BEZIER_APPROX_OK) {
+        controlsSize = 0;
+    }
+    completeJob(worker->pipeline, job, result, worker->scratch.controlsBuffer, controlsSize);
+}
+
+static int workerMain(void* arg) {
+    BezierPipelineWorker* worker = (BezierPipelineWorker*)arg;
+    BezierApproxPipeline* pipeline = worker->pipeline;
+    BezierPipelineJob job;
+
+    for (;;) {
+        if (popJob(pipeline, &job)) {
+            atomic_fetch_sub(&pipeline->queued, 1);
+            processJob(worker, &job);
+            continue;
+        }
+        if (atomic_load(&pipeline->stop)) {
+            break;
+        }
+
+        mtx_lock(&pipeline->idleLock);
+        atomic_fetch_add(&pipeline->idleWorkers, 1);
+        while (atomic_load(&pipeline->queued) == 0 && !atomic_load(&pipeline->stop)) {
+            cnd_wait(&pipeline->idleCond, &pipeline->idleLock);
+        }
+        atomic_fetch_sub(&pipeline->idleWorkers, 1);
+        mtx_unlock(&pipeline->idleLock);
+    }
+    return 0;
+}
+
+static void freePipeline(BezierApproxPipeline* pipeline) {
+    if (pipeline->workers) {
+        for (int i = 0; i < pipeline->workersCount; ++i) {
+            bezierApproxScratchFree(&pipeline->workers[i].scratch);
+        }
+        free(pipeline->workers);
+        pipeline->workers = NULL;
+    }
+    if (pipeline->streams) {
+        for (int i = 0; i < pipeline->streamsCount; ++i) {
+            BezierPipelineStream* stream = &pipeline->streams[i];
+            for (int j = 0; j < stream->pendingSize; ++j) {
+                free(stream->pending[j].controls);
+            }
+            free(stream->pending);
+            mtx_destroy(&stream->lock);
+        }
+        free(pipeline->streams);
+        pipeline->streams = NULL;
+    }
+    if (pipeline->cells) {
+        free(pipeline->cells);
+        pipeline->cells = NULL;
+    }
+    cnd_destroy(&pipeline->flushCond);
+    mtx_destroy(&pipeline->flushLock);
+    cnd_destroy(&pipeline->idleCond);
+    mtx_destroy(&pipeline->idleLock);
+    free(pipeline);
+}
+
+int bezierApproxPipelineCreate(
+    int workersCount,
+    int queueCapacity,
+    int streamsCount,
+    BezierApproxPipelineCallback callback,
+    void* userData,
+    BezierApproxPipeline** pipeline
+) {
+    int result = BEZIER_APPROX_FAILED;
+    BezierApproxPipeline* ans = NULL;
+
+    if (workersCount < 1 || queueCapacity < 1 || streamsCount < 1 || !callback || !pipeline) {
+        result = BEZIER_APPROX_ARGUMENTS_ERROR;
+        goto cleanup;
+    }
+
+    ans = (BezierApproxPipeline*)calloc(1, sizeof(BezierApproxPipeline));
+    if (!ans) {
+        goto cleanup;
+    }
+    if (mtx_init(&ans->idleLock, mtx_plain) != thrd_success) {
+        free(ans);
+        ans = NULL;
+        goto cleanup;
+    }
+    if (cnd_init(&ans->idleCond) != thrd_success) {
+        mtx_destroy(&ans->idleLock);
+        free(ans);
+        ans = NULL;
+        goto cleanup;
+    }
+    if (mtx_init(&ans->flushLock, mtx_plain) != thrd_success) {
+        cnd_destroy(&ans->idleCond);
+        mtx_destroy(&ans->idleLock);
+        free(ans);
+        ans = NULL;
+        goto cleanup;
+    }
+    if (cnd_init(&ans->flushCond) != thrd_success) {
+        mtx_destroy(&ans->flushLock);
+        cnd_destroy(&ans->idleCond);
+        mtx_destroy(&ans->idleLock);
+        free(ans);
+        ans = NULL;
+        goto cleanup;
+    }
+    ans->callback = callback;
+    ans->userData = userData;
+
+    size_t cellsCount = 1;
+    while (cellsCount < (size_t)queueCapacity) {
+        cellsCount <<= 1;
+    }
+    ans->cells = (BezierPipelineCell*)malloc(sizeof(BezierPipelineCell) * cellsCount);
+    if (!ans->cells) {
+        goto cleanup;
+    }
+    for (size_t i = 0; i < cellsCount; ++i) {
+        atomic_init(&ans->cells[i].sequence, i);
+    }
+    ans->cellsMask = cellsCount - 1;
+
+    // Submit keeps the undelivered jobs of a stream below this, so parked
+    // results always fit.
+    ans->pendingCapacity = (int)cellsCount + workersCount;
+    ans->streams = (BezierPipelineStream*)calloc(streamsCount, sizeof(BezierPipelineStream));
+    if (!ans->streams) {
+        goto cleanup;
+    }
+    for (int i = 0; i < streamsCount; ++i) {
+        BezierPipelineStream* stream = &ans->streams[i];
+        stream->pending = (BezierPipelinePendingResult*)malloc(
+            sizeof(BezierPipelinePendingResult) * ans->pendingCapacity
+        );
+        if (!stream->pending || mtx_init(&stream->lock, mtx_plain) != thrd_success) {
+            free(stream->pending);
+            stream->pending = NULL;
+            goto cleanup;
+        }
+        ++ans->streamsCount;
+    }
+
+    ans->workers = (BezierPipelineWorker*)calloc(workersCount, sizeof(BezierPipelineWorker));
+    if (!ans->workers) {
+        goto cleanup;
+    }
+    ans->workersCount = workersCount;
+    for (int i = 0; i < workersCount; ++i) {
+        BezierPipelineWorker* worker = &ans->workers[i];
+        worker->pipeline = ans;
+        if (thrd_create(&worker->thread, workerMain, worker) != thrd_success) {
+            goto cleanup;
+        }
+        worker->started = 1;
+    }
+
+    *pipeline = ans;
+    ans = NULL;
+    result = BEZIER_APPROX_OK;
+
+cleanup:
+    if (ans) {
+        bezierApproxPipelineDestroy(ans);
+        ans = NULL;
+    }
+    return result;
+}
+
+int bezierApproxPipelineSubmit(
+    BezierApproxPipeline* pipeline,
+    int streamId,
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision
+) {
+    if (streamId < 0 || streamId >= pipeline->streamsCount) {
+        return BEZIER_APPROX_ARGUMENTS_ERROR;
+    }
+
+    BezierPipelineStream* stream = &pipeline->streams[streamId];
+    BezierPipelineJob job;
+    job.points = points;
+    job.pointsSize = pointsSize;
+    job.precision = precision;
+    job.streamId = streamId;
+    job.submitTime = getTimeSeconds();
+
+    // Counted before the push, so workers never see more jobs than queued.
+    atomic_fetch_add(&pipeline->queued, 1);
+
+    // The stream lock keeps sequence numbers in queue order without gaps.
+    // One slow job must not let later results of its stream pile up without
+    // bound while they wait for it. The result in a callback is never
+    // parked, so it doesn't count, and a callback can always submit one
+    // polyline for the one it got.
+    mtx_lock(&stream->lock);
+    job.sequence = stream->nextSubmit;
+    int result = BEZIER_APPROX_QUEUE_FULL;
+    const unsigned long long undelivered = stream->nextSubmit - stream->nextDeliver - stream->delivering;
+    if (undelivered < (unsigned long long)pipeline->pendingCapacity) {
+        result = pushJob(pipeline, &job);
+    }
+    if (result == BEZIER_APPROX_OK) {
+        ++stream->nextSubmit;
+        atomic_fetch_add(&pipeline->submitted, 1);
+    }
+    mtx_unlock(&stream->lock);
+
+    if (result != BEZIER_APPROX_OK) {
+        atomic_fetch_sub(&pipeline->queued, 1);
+        atomic_fetch_add(&pipeline->rejected, 1);
+        return result;
+    }
+
+    if (atomic_load(&pipeline->idleWorkers) > 0) {
+        mtx_lock(&pipeline->idleLock);
+        cnd_signal(&pipeline->idleCond);
+        mtx_unlock(&pipeline->idleLock);
+    }
+    return BEZIER_APPROX_OK;
+}
+
+void bezierApproxPipelineFlush(
+    BezierApproxPipeline* pipeline
+) {
+    mtx_lock(&pipeline->flushLock);
+    atomic_fetch_add(&pipeline->flushWaiters, 1);
+    while (atomic_load(&pipeline->completed) < atomic_load(&pipeline->submitted)) {
+        cnd_wait(&pipeline->flushCond, &pipeline->flushLock);
+    }
+    atomic_fetch_sub(&pipeline->flushWaiters, 1);
+    mtx_unlock(&pipeline->flushLock);
+}
+
+void bezierApproxPipelineGetStats(
+    BezierApproxPipeline* pipeline,
+    BezierApproxPipelineStats* stats
+) {
+    stats->submitted = atomic_load(&pipeline->submitted);
+    stats->rejected = atomic_load(&pipeline->rejected);
+    stats->completed = atomic_load(&pipeline->completed);
+    stats->queueDepth = atomic_load(&pipeline->queued);
+    stats->meanLatency = 0.0;
+    stats->p99Latency = 0.0;
+    stats->maxLatency = 1.0e-9 * (double)atomic_load(&pipeline->latencyMaxNs);
+
+    unsigned long long count = 0;
+    for (int i = 0; i < LATENCY_BUCKETS_COUNT; ++i) {
+        count += atomic_load(&pipeline->latencyBuckets[i]);
+    }
+    if (count == 0) {
+        return;
+    }
+    stats->meanLatency = 1.0e-9 * (double)atomic_load(&pipeline->latencySumNs) / (double)count;
+
+    // Reported as the upper bound of the histogram bucket holding the 99th
+    // percentile.
+    unsigned long long p99Count = count - count / 100;
+    unsigned long long accumulated = 0;
+    for (int i = 0; i < LATENCY_BUCKETS_COUNT; ++i) {
+        accumulated += atomic_load(&pipeline->latencyBuckets[i]);
+        if (accumulated >= p99Count) {
+            stats->p99Latency = 1.0e-9 * pow(2.0, (double)(i + 1) / LATENCY_BUCKETS_PER_OCTAVE);
+            break;
+        }
+    }
+    if (stats->p99Latency > stats->maxLatency) {
+        stats->p99Latency = stats->maxLatency;
+    }
+}
+
+void bezierApproxPipelineDestroy(
+    BezierApproxPipeline* pipeline
+) {
+    if (!pipeline) {
+        return;
+    }
+
+    mtx_lock(&pipeline->idleLock);
+    atomic_store(&pipeline->stop, 1);
+    cnd_broadcast(&pipeline->idleCond);
+    mtx_unlock(&pipeline->idleLock);
+
+    if (pipeline->workers) {
+        for (int i = 0; i < pipeline->workersCount; ++i) {
+            if (pipeline->workers[i].started) {
+                thrd_join(pipeline->workers[i].thread, NULL);
+            }
+        }
+    }
+    freePipeline(pipeline);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "bezierapprox.h"
+
+#define EPS_ZERO 1.0e-9
+
+// Subdivision loops are cloned for newer x86-64 levels and the best clone
+// is picked when the library is loaded.
+#if BEZIERAPPROXLIB_MULTIVERSIONING
+#define TARGET_CLONES __attribute__((target_clones("default", "arch=x86-64-v2", "arch=x86-64-v3", "arch=x86-64-v4")))
+#else
+#define TARGET_CLONES
+#endif
+
+// Buffers that a long lived caller, such as a pipeline worker, keeps between
+// fits instead of allocating them for every polyline.
+typedef struct _BezierApproxScratch {
+    double* tDist;
+    struct _BezierControlsStackEntry* controlsStack;
+    BezierApproxCurve3Controls* controlsBuffer;
+    int capacity;
+} BezierApproxScratch;
+
+// Grows the buffers to hold pointsSize points, they are never shrunk.
+int bezierApproxScratchReserve(
+    BezierApproxScratch* scratch,
+    int pointsSize
+);
+
+void bezierApproxScratchFree(
+    BezierApproxScratch* scratch
+);
+
+// Same as bezierApprox, but the curves are stored into
+// scratch->controlsBuffer and nothing is allocated once the scratch is large
+// enough.
+int bezierApproxWithScratch(
+    const BezierApproxPoint points[],
+    int pointsSize,
+    double precision,
+    BezierApproxScratch* scratch,
+    int* controlsSize
+);
@@ -0,0 +1,217 @@
+#include "bezierapprox.h"
+#include "bezierapproxinline.h"
+#include "bezierapproxprivate.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// The x coordinates of the controls are fixed at the thirds of the segment,
+// so x(t) is linear and only the inner y coordinates are stored.
+typedef struct _BezierTimeSeriesStackEntry {
+    double y1;
+    double y2;
+    int firstIdx;
+    int lastIdx;
+} BezierTimeSeriesStackEntry;
+
+// One dimensional least squares for the inner y coordinates. Falls back to a
+// straight line if the system is degenerate.
+static inline void fitSegment(
+    const double timestamps[],
+    const double values[],
+    BezierTimeSeriesStackEntry* entry
+) {
+    const int firstIdx = entry->firstIdx;
+    const int lastIdx = entry->lastIdx;
+    const double x0 = timestamps[firstIdx];
+    const double invDx = 1.0 / (timestamps[lastIdx] - x0);
+    const double y0 = values[firstIdx];
+    const double y3 = values[lastIdx];
+
+    entry->y1 = (2.0 * y0 + y3) / 3.0;
+    entry->y2 = (y0 + 2.0 * y3) / 3.0;
+    if (lastIdx - firstIdx < 3) {
+        return;
+    }
+
+    double A11 = 0.0;
+    double A12 = 0.0;
+    double A22 = 0.0;
+    double D1 = 0.0;
+    double D2 = 0.0;
+    for (int i = firstIdx + 1; i < lastIdx; ++i) {
+        double b[4];
+        bezierApproxInlineBasis((timestamps[i] - x0) * invDx, b);
+
+        A11 += b[1] * b[1];
+        A12 += b[1] * b[2];
+        A22 += b[2] * b[2];
+
+        double dPart = values[i] - y0 * b[0] - y3 * b[3];
+        D1 += dPart * b[1];
+        D2 += dPart * b[2];
+    }
+
+    double detA = A11 * A22 - A12 * A12;
+    if (fabs(detA) < EPS_ZERO) {
+        return;
+    }
+    entry->y1 = (A22 * D1 - A12 * D2) / detA;
+    entry->y2 = (A11 * D2 - A12 * D1) / detA;
+}
+
+// Since the curve passes every timestamp at its own parameter, the vertical
+// distance is the distance to the point of the curve at that parameter.
+static inline void getMaxVerticalDistance(
+    const double timestamps[],
+    const double values[],
+    const BezierTimeSeriesStackEntry* entry,
+    double* maxDist,
+    int* maxDistIdx
+) {
+    const int firstIdx = entry->firstIdx;
+    const int lastIdx = entry->lastIdx;
+    const double x0 = timestamps[firstIdx];
+    const double invDx = 1.0 / (timestamps[lastIdx] - x0);
+    const double y0 = values[firstIdx];
+    const double y3 = values[lastIdx];
+
+    *maxDist = 0.0;
+    *maxDistIdx = firstIdx;
+    for (int i = firstIdx + 1; i < lastIdx; ++i) {
+        double b[4];
+        bezierApproxInlineBasis((timestamps[i] - x0) * invDx, b);
+        double y = b[0] * y0 + b[1] * entry->y1 + b[2] * entry->y2 + b[3] * y3;
+        double dist = fabs(y - values[i]);
+        if (dist > *maxDist) {
+            *maxDist = dist;
+            *maxDistIdx = i;
+        }
+    }
+}
+
+static inline void fillControls(
+    const double timestamps[],
+    const double values[],
+    const BezierTimeSeriesStackEntry* entry,
+    BezierApproxCurve3Controls* controls
+) {
+    const double x0 = timestamps[entry->firstIdx];
+    const double x3 = timestamps[entry->lastIdx];
+    controls->P0.x = x0;
+    controls->P0.y = values[entry->firstIdx];
+    controls->P1.x = (2.0 * x0 + x3) / 3.0;
+    controls->P1.y = entry->y1;
+    controls->P2.x = (x0 + 2.0 * x3) / 3.0;
+    controls->P2.y = entry->y2;
+    controls->P3.x = x3;
+    controls->P3.y = values[entry->lastIdx];
+}
+
+TARGET_CLONES
+static int approxTimeSeries(
+    const double timestamps[],
+    const double values[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    int result = BEZIER_APPROX_FAILED;
+    const int controlsStackCapacity = pointsSize - 1;
+    int controlsStackSize = 0;
+    BezierTimeSeriesStackEntry* controlsStack = NULL;
+    int controlsAnsSize = 0;
+
+    controlsStack = (BezierTimeSeriesStackEntry*)malloc(
+        sizeof(BezierTimeSeriesStackEntry) * controlsStackCapacity
+    );
+    if (!controlsStack) {
+        goto cleanup;
+    }
+
+    controlsStack[0].firstIdx = 0;
+    controlsStack[0].lastIdx = pointsSize - 1;
+    fitSegment(timestamps, values, &controlsStack[0]);
+    controlsStackSize = 1;
+
+    // Curves that don't fit into controlsBuffer are only counted.
+    while (controlsStackSize > 0) {
+        BezierTimeSeriesStackEntry entry = controlsStack[--controlsStackSize];
+        double maxDist;
+        int maxDistIdx;
+        getMaxVerticalDistance(timestamps, values, &entry, &maxDist, &maxDistIdx);
+        if (maxDist <= precision || entry.lastIdx - entry.firstIdx < 2) {
+            if (controlsAnsSize < *controlsBufferSize) {
+                fillControls(timestamps, values, &entry, &controlsBuffer[controlsAnsSize]);
+            }
+            ++controlsAnsSize;
+            continue;
+        }
+
+        // Pinned end points make the worst point of a long segment sit next
+        // to its end, and splitting there would peel off a few points at a
+        // time. Keeping the split in the middle half bounds the depth.
+        const int quarter = (entry.lastIdx - entry.firstIdx) / 4;
+        if (maxDistIdx < entry.firstIdx + quarter) {
+            maxDistIdx = entry.firstIdx + quarter;
+        }
+        if (maxDistIdx > entry.lastIdx - quarter) {
+            maxDistIdx = entry.lastIdx - quarter;
+        }
+
+        BezierTimeSeriesStackEntry* right = &controlsStack[controlsStackSize++];
+        right->firstIdx = maxDistIdx;
+        right->lastIdx = entry.lastIdx;
+        fitSegment(timestamps, values, right);
+
+        BezierTimeSeriesStackEntry* left = &controlsStack[controlsStackSize++];
+        left->firstIdx = entry.firstIdx;
+        left->lastIdx = maxDistIdx;
+        fitSegment(timestamps, values, left);
+    }
+
+    result = controlsAnsSize > *controlsBufferSize ? BEZIER_APPROX_BUFFER_TOO_SMALL : BEZIER_APPROX_OK;
+    *controlsBufferSize = controlsAnsSize;
+
+cleanup:
+    if (controlsStack) {
+        free(controlsStack);
+        controlsStack = NULL;
+    }
+    return result;
+}
+
+int bezierApproxTimeSeries(
+    const double timestamps[],
+    const double values[],
+    int pointsSize,
+    double precision,
+    BezierApproxCurve3Controls* controlsBuffer,
+    int* controlsBufferSize
+) {
+    if (pointsSize < 1) {
+        return BEZIER_APPROX_NOT_ENOUGH_POINTS_ERROR;
+    }
+    for (int i = 0; i < pointsSize; ++i) {
+        if (isnan(values[i]) || (i > 0 && !(timestamps[i] > timestamps[i - 1]))) {
+            return BEZIER_APPROX_ARGUMENTS_ERROR;
+        }
+    }
+
+    if (pointsSize == 1) {
+        if (*controlsBufferSize < 1) {
+            *controlsBufferSize = 1;
+            return BEZIER_APPROX_BUFFER_TOO_SMALL;
+        }
+        *controlsBufferSize = 1;
+        BezierApproxPoint point = { timestamps[0], values[0] };
+        controlsBuffer[0].P0 = point;
+        controlsBuffer[0].P1 = point;
+        controlsBuffer[0].P2 = point;
+        controlsBuffer[0].P3 = point;
+        return BEZIER_APPROX_OK;
+    }
+
+    return approxTimeSeries(timestamps, values, pointsSize, precision, controlsBuffer, controlsBufferSize);
+}
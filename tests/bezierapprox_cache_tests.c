@@ -0,0 +1,417 @@
+#include <bezierapproxcache.h>
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#define STROKE_VARIANTS 8
+#define STROKE_POINTS 500
+#define THREADS_COUNT 4
+#define FITS_PER_THREAD 200
+#define CACHE_FILE "bezierapprox_cache_tests.bin"
+
+typedef struct _Strokes {
+    BezierApproxPoint* points[STROKE_VARIANTS];
+    BezierApproxCurve3Controls* expected[STROKE_VARIANTS];
+    int expectedSize[STROKE_VARIANTS];
+} Strokes;
+
+typedef struct _FitterArgs {
+    BezierApproxCache* cache;
+    const Strokes* strokes;
+    int threadId;
+    atomic_int* errors;
+} FitterArgs;
+
+static void freeStrokes(Strokes* strokes) {
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        free(strokes->points[v]);
+        strokes->points[v] = NULL;
+        free(strokes->expected[v]);
+        strokes->expected[v] = NULL;
+    }
+}
+
+static bool initStrokes(Strokes* strokes) {
+    memset(strokes, 0, sizeof(*strokes));
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        strokes->points[v] = (BezierApproxPoint*)malloc(STROKE_POINTS * sizeof(BezierApproxPoint));
+        strokes->expected[v] = (BezierApproxCurve3Controls*)
+            malloc((STROKE_POINTS - 1) * sizeof(BezierApproxCurve3Controls));
+        if (!strokes->points[v] || !strokes->expected[v]) {
+            freeStrokes(strokes);
+            return false;
+        }
+        for (int i = 0; i < STROKE_POINTS; ++i) {
+            strokes->points[v][i].x = i;
+            strokes->points[v][i].y = 40.0 * sin(0.03 * i * (v + 1)) + 10.0 * sin(0.2 * i);
+        }
+        strokes->expectedSize[v] = STROKE_POINTS - 1;
+        if (bezierApprox(strokes->points[v], STROKE_POINTS, 0.5,
+            strokes->expected[v], &strokes->expectedSize[v]) != BEZIER_APPROX_OK) {
+            freeStrokes(strokes);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkFit(
+    BezierApproxCache* cache,
+    const Strokes* strokes,
+    int variant,
+    BezierApproxCurve3Controls* controlsBuffer
+) {
+    int controlsBufferSize = STROKE_POINTS - 1;
+    int result = bezierApproxCacheFit(
+        cache,
+        strokes->points[variant],
+        STROKE_POINTS,
+        0.5,
+        BEZIER_APPROX_TANGENT_CENTRAL,
+        0,
+        controlsBuffer,
+        &controlsBufferSize
+    );
+    return result == BEZIER_APPROX_OK &&
+        controlsBufferSize == strokes->expectedSize[variant] &&
+        memcmp(controlsBuffer, strokes->expected[variant],
+            controlsBufferSize * sizeof(BezierApproxCurve3Controls)) == 0;
+}
+
+bool test_cacheHits() {
+    bool success = true;
+    Strokes strokes;
+    BezierApproxCache* cache = NULL;
+    BezierApproxCurve3Controls controlsBuffer[STROKE_POINTS - 1];
+    BezierApproxCacheStats stats;
+
+    if (!initStrokes(&strokes)) {
+        return false;
+    }
+    if (bezierApproxCacheCreate(1 << 20, NULL, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+
+    success &= checkFit(cache, &strokes, 0, controlsBuffer);
+    success &= checkFit(cache, &strokes, 0, controlsBuffer);
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.hits == 1 && stats.misses == 1 && stats.entriesCount == 1);
+
+    // Other precision and options are other keys, the window is ignored by
+    // the central difference.
+    int controlsBufferSize = STROKE_POINTS - 1;
+    int result = bezierApproxCacheFit(cache, strokes.points[0], STROKE_POINTS, 0.25,
+        BEZIER_APPROX_TANGENT_CENTRAL, 0, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    controlsBufferSize = STROKE_POINTS - 1;
+    result = bezierApproxCacheFit(cache, strokes.points[0], STROKE_POINTS, 0.5,
+        BEZIER_APPROX_TANGENT_LEAST_SQUARES, 4, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    controlsBufferSize = STROKE_POINTS - 1;
+    result = bezierApproxCacheFit(cache, strokes.points[0], STROKE_POINTS, 0.5,
+        BEZIER_APPROX_TANGENT_CENTRAL, 7, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.hits == 2 && stats.misses == 3 && stats.entriesCount == 3);
+
+    controlsBufferSize = 1;
+    result = bezierApproxCacheFit(cache, strokes.points[0], STROKE_POINTS, 0.5,
+        BEZIER_APPROX_TANGENT_CENTRAL, 0, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_BUFFER_TOO_SMALL);
+    success &= (controlsBufferSize == strokes.expectedSize[0]);
+    if (!success) {
+        printf("test_cacheHits failed.\n");
+    }
+
+cleanup:
+    if (cache) {
+        bezierApproxCacheDestroy(cache);
+        cache = NULL;
+    }
+    freeStrokes(&strokes);
+    return success;
+}
+
+static int fitShifted(
+    BezierApproxCache* cache,
+    const Strokes* strokes,
+    BezierApproxPoint* points,
+    int shift,
+    BezierApproxCurve3Controls* controlsBuffer
+) {
+    for (int i = 0; i < STROKE_POINTS; ++i) {
+        points[i].x = strokes->points[0][i].x;
+        points[i].y = strokes->points[0][i].y + shift;
+    }
+    int controlsBufferSize = STROKE_POINTS - 1;
+    return bezierApproxCacheFit(cache, points, STROKE_POINTS, 0.5,
+        BEZIER_APPROX_TANGENT_CENTRAL, 0, controlsBuffer, &controlsBufferSize);
+}
+
+bool test_cacheEviction() {
+    bool success = true;
+    Strokes strokes;
+    BezierApproxCache* cache = NULL;
+    BezierApproxPoint points[STROKE_POINTS];
+    BezierApproxCurve3Controls controlsBuffer[STROKE_POINTS - 1];
+    BezierApproxCacheStats stats;
+    const int shiftsCount = 64;
+
+    if (!initStrokes(&strokes)) {
+        return false;
+    }
+
+    // About two results per shard, far less than the shifted strokes.
+    const size_t capacity = 16 * 2 * (256 + sizeof(BezierApproxCurve3Controls) * strokes.expectedSize[0]);
+    if (bezierApproxCacheCreate(capacity, NULL, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+
+    for (int shift = 0; shift < shiftsCount; ++shift) {
+        success &= (fitShifted(cache, &strokes, points, shift, controlsBuffer) == BEZIER_APPROX_OK);
+    }
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.misses == (unsigned long long)shiftsCount);
+    success &= (stats.evictions > 0);
+    success &= (stats.evictions == stats.misses - (unsigned long long)stats.entriesCount);
+    success &= (stats.bytesUsed <= capacity);
+
+    // The most recent result is always kept.
+    success &= (fitShifted(cache, &strokes, points, shiftsCount - 1, controlsBuffer) == BEZIER_APPROX_OK);
+    BezierApproxCacheStats after;
+    bezierApproxCacheGetStats(cache, &after);
+    success &= (after.hits == stats.hits + 1);
+    if (!success) {
+        printf("test_cacheEviction failed.\n");
+    }
+
+cleanup:
+    if (cache) {
+        bezierApproxCacheDestroy(cache);
+        cache = NULL;
+    }
+    freeStrokes(&strokes);
+    return success;
+}
+
+static int fitterMain(void* arg) {
+    FitterArgs* args = (FitterArgs*)arg;
+    BezierApproxCurve3Controls* controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc((STROKE_POINTS - 1) * sizeof(BezierApproxCurve3Controls));
+    if (!controlsBuffer) {
+        atomic_fetch_add(args->errors, 1);
+        return 0;
+    }
+    for (int i = 0; i < FITS_PER_THREAD; ++i) {
+        int variant = (i * 7 + args->threadId) % STROKE_VARIANTS;
+        if (!checkFit(args->cache, args->strokes, variant, controlsBuffer)) {
+            atomic_fetch_add(args->errors, 1);
+        }
+    }
+    free(controlsBuffer);
+    return 0;
+}
+
+bool test_cacheConcurrent() {
+    bool success = true;
+    Strokes strokes;
+    BezierApproxCache* cache = NULL;
+    thrd_t threads[THREADS_COUNT];
+    FitterArgs args[THREADS_COUNT];
+    atomic_int errors;
+    BezierApproxCacheStats stats;
+
+    atomic_init(&errors, 0);
+    if (!initStrokes(&strokes)) {
+        return false;
+    }
+    if (bezierApproxCacheCreate(1 << 20, NULL, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+
+    for (int t = 0; t < THREADS_COUNT; ++t) {
+        args[t].cache = cache;
+        args[t].strokes = &strokes;
+        args[t].threadId = t;
+        args[t].errors = &errors;
+        thrd_create(&threads[t], fitterMain, &args[t]);
+    }
+    for (int t = 0; t < THREADS_COUNT; ++t) {
+        thrd_join(threads[t], NULL);
+    }
+
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (atomic_load(&errors) == 0);
+    success &= (stats.hits + stats.misses == THREADS_COUNT * FITS_PER_THREAD);
+    success &= (stats.misses >= STROKE_VARIANTS);
+    success &= (stats.entriesCount == STROKE_VARIANTS);
+    success &= (stats.evictions == 0);
+    printf("cache: %d threads, %llu hits, %llu misses\n", THREADS_COUNT, stats.hits, stats.misses);
+    if (!success) {
+        printf("test_cacheConcurrent failed.\n");
+    }
+
+cleanup:
+    if (cache) {
+        bezierApproxCacheDestroy(cache);
+        cache = NULL;
+    }
+    freeStrokes(&strokes);
+    return success;
+}
+
+bool test_cachePersistence() {
+    bool success = true;
+    Strokes strokes;
+    BezierApproxCache* cache = NULL;
+    BezierApproxCurve3Controls controlsBuffer[STROKE_POINTS - 1];
+    BezierApproxCacheStats stats;
+
+    remove(CACHE_FILE);
+    if (!initStrokes(&strokes)) {
+        return false;
+    }
+    if (bezierApproxCacheCreate(1 << 20, CACHE_FILE, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        success &= checkFit(cache, &strokes, v, controlsBuffer);
+    }
+    success &= (bezierApproxCacheSave(cache) == BEZIER_APPROX_OK);
+    bezierApproxCacheDestroy(cache);
+    cache = NULL;
+
+    if (bezierApproxCacheCreate(1 << 20, CACHE_FILE, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.entriesCount == STROKE_VARIANTS);
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        success &= checkFit(cache, &strokes, v, controlsBuffer);
+    }
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.hits == STROKE_VARIANTS && stats.misses == 0);
+    bezierApproxCacheDestroy(cache);
+    cache = NULL;
+
+    // A damaged file is ignored.
+    FILE* file = fopen(CACHE_FILE, "wb");
+    if (file) {
+        fputs("not a cache", file);
+        fclose(file);
+    }
+    if (bezierApproxCacheCreate(1 << 20, CACHE_FILE, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.entriesCount == 0);
+    if (!success) {
+        printf("test_cachePersistence failed.\n");
+    }
+
+cleanup:
+    if (cache) {
+        bezierApproxCacheDestroy(cache);
+        cache = NULL;
+    }
+    remove(CACHE_FILE);
+    freeStrokes(&strokes);
+    return success;
+}
+
+// Saves don't hold the shard locks while writing, so they run next to the
+// fitters, and the last one still has every entry.
+bool test_cacheSaveConcurrent() {
+    bool success = true;
+    Strokes strokes;
+    BezierApproxCache* cache = NULL;
+    thrd_t threads[THREADS_COUNT];
+    FitterArgs args[THREADS_COUNT];
+    BezierApproxCurve3Controls controlsBuffer[STROKE_POINTS - 1];
+    atomic_int errors;
+    BezierApproxCacheStats stats;
+
+    atomic_init(&errors, 0);
+    remove(CACHE_FILE);
+    if (!initStrokes(&strokes)) {
+        return false;
+    }
+    if (bezierApproxCacheCreate(1 << 20, CACHE_FILE, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+
+    for (int t = 0; t < THREADS_COUNT; ++t) {
+        args[t].cache = cache;
+        args[t].strokes = &strokes;
+        args[t].threadId = t;
+        args[t].errors = &errors;
+        thrd_create(&threads[t], fitterMain, &args[t]);
+    }
+    for (int i = 0; i < 20; ++i) {
+        success &= (bezierApproxCacheSave(cache) == BEZIER_APPROX_OK);
+    }
+    for (int t = 0; t < THREADS_COUNT; ++t) {
+        thrd_join(threads[t], NULL);
+    }
+    success &= (atomic_load(&errors) == 0);
+    bezierApproxCacheDestroy(cache);
+    cache = NULL;
+
+    if (bezierApproxCacheCreate(1 << 20, CACHE_FILE, &cache) != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        success &= checkFit(cache, &strokes, v, controlsBuffer);
+    }
+    bezierApproxCacheGetStats(cache, &stats);
+    success &= (stats.entriesCount == STROKE_VARIANTS);
+    success &= (stats.hits == STROKE_VARIANTS && stats.misses == 0);
+    if (!success) {
+        printf("test_cacheSaveConcurrent failed.\n");
+    }
+
+cleanup:
+    if (cache) {
+        bezierApproxCacheDestroy(cache);
+        cache = NULL;
+    }
+    remove(CACHE_FILE);
+    freeStrokes(&strokes);
+    return success;
+}
+
+bool runAllTests() {
+    bool success = true;
+    success &= test_cacheHits();
+    success &= test_cacheEviction();
+    success &= test_cacheConcurrent();
+    success &= test_cachePersistence();
+    success &= test_cacheSaveConcurrent();
+    return success;
+}
+
+int main() {
+    bool success = runAllTests();
+    int errorCode = 0;
+    if (success) {
+        printf("SUCCESS");
+    }
+    else {
+        printf("FAILED");
+        errorCode = 1;
+    }
+    return errorCode;
+}
@@ -0,0 +1,175 @@
+#include <bezierapprox.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define EPS 0.05
+
+namespace {
+
+const BezierApproxPoint P0 = { 50.0, 300.0 };
+const BezierApproxPoint P1 = { 150.0, -150.0 };
+const BezierApproxPoint P2 = { 250.0, 450.0 };
+const BezierApproxPoint P3 = { 350.0, 50.0 };
+
+const int N = 8;
+const double t[] = { 0.0, 0.05, 0.2, 0.4, 0.6, 0.8, 0.95, 1.0 };
+
+inline bool epsNear(double a, double b) {
+    return std::fabs(a - b) < EPS;
+}
+
+inline bool pointsNear(const BezierApproxPoint& a, const BezierApproxPoint& b) {
+    return epsNear(a.x, b.x) && epsNear(a.y, b.y);
+}
+
+inline bool pointsNear(const BezierApproxPointF& a, const BezierApproxPoint& b) {
+    return epsNear(a.x, b.x) && epsNear(a.y, b.y);
+}
+
+template <typename C>
+inline bool controlsNear(const C& a, const BezierApproxCurve3Controls& b) {
+    return pointsNear(a.P0, b.P0) && pointsNear(a.P1, b.P1) && pointsNear(a.P2, b.P2) && pointsNear(a.P3, b.P3);
+}
+
+std::vector<BezierApproxPoint> wavePoints(int pointsSize) {
+    std::vector<BezierApproxPoint> points(pointsSize);
+    for (int i = 0; i < pointsSize; ++i) {
+        const double x = i * 0.5;
+        points[i].x = x;
+        points[i].y = 40.0 * std::sin(x * 0.05) + 5.0 * std::sin(x * 0.4);
+    }
+    return points;
+}
+
+} // namespace
+
+bool test_evaluate() {
+    bool success = true;
+    const BezierApproxCurve3Controls controls = { P0, P1, P2, P3 };
+    BezierApproxCurve3ControlsF controlsF = {
+        { float(P0.x), float(P0.y) },
+        { float(P1.x), float(P1.y) },
+        { float(P2.x), float(P2.y) },
+        { float(P3.x), float(P3.y) }
+    };
+    for (int i = 0; i < N; ++i) {
+        const BezierApproxPoint expected = bezierApproxGetCurveValue(controls, t[i]);
+        success &= pointsNear(bezierapprox::evaluate<double>(controls, t[i]), expected);
+        success &= pointsNear(bezierapprox::evaluate<float>(controlsF, float(t[i])), expected);
+    }
+    return success;
+}
+
+bool test_fitOneCurve() {
+    bool success = true;
+    const BezierApproxCurve3Controls controls = { P0, P1, P2, P3 };
+    BezierApproxPoint points[N];
+    for (int i = 0; i < N; ++i) {
+        points[i] = bezierApproxGetCurveValue(controls, t[i]);
+    }
+
+    BezierApproxCurve3Controls expected;
+    success &= (bezierApproxByOneCurve(points, 0, N - 1, &expected) == BEZIER_APPROX_OK);
+
+    double tDist[N];
+    bezierapprox::arcLengths(points, N, tDist);
+    BezierApproxPoint e1 = bezierapprox::detail::substruct(points[1], points[0]);
+    BezierApproxPoint e2 = bezierapprox::detail::substruct(points[N - 2], points[N - 1]);
+    success &= bezierapprox::detail::normalize(e1) && bezierapprox::detail::normalize(e2);
+
+    BezierApproxCurve3Controls ans;
+    success &= (bezierapprox::fitOneCurve(points, tDist, 0, N - 1, e1, e2, ans) == BEZIER_APPROX_OK);
+    success &= controlsNear(ans, expected);
+
+    double maxDist;
+    int maxDistIdx;
+    bezierapprox::maxDistance(ans, points, tDist, 0, N - 1, maxDist, maxDistIdx);
+    success &= (maxDistIdx >= 0 && maxDistIdx < N);
+    success &= (maxDist >= 0.0);
+    return success;
+}
+
+bool test_fitDouble() {
+    bool success = true;
+    const int pointsSize = 500;
+    const double precision = 0.5;
+    const std::vector<BezierApproxPoint> points = wavePoints(pointsSize);
+
+    std::vector<BezierApproxCurve3Controls> expected(pointsSize - 1);
+    int expectedSize = pointsSize - 1;
+    success &= (bezierApprox(points.data(), pointsSize, precision, expected.data(), &expectedSize) == BEZIER_APPROX_OK);
+
+    std::vector<BezierApproxCurve3Controls> ans(pointsSize - 1);
+    int ansSize = pointsSize - 1;
+    success &= (bezierapprox::fit<double>(points.data(), pointsSize, precision, ans.data(), &ansSize) == BEZIER_APPROX_OK);
+
+    success &= (ansSize == expectedSize);
+    for (int i = 0; success && i < ansSize; ++i) {
+        success &= controlsNear(ans[i], expected[i]);
+    }
+
+    int smallSize = 0;
+    success &= (bezierapprox::fit<double>(points.data(), pointsSize, precision, ans.data(), &smallSize) ==
+        BEZIER_APPROX_BUFFER_TOO_SMALL);
+    success &= (smallSize == expectedSize);
+    return success;
+}
+
+bool test_fitFloat() {
+    bool success = true;
+    const int pointsSize = 500;
+    const std::vector<BezierApproxPoint> points = wavePoints(pointsSize);
+    std::vector<BezierApproxPointF> pointsF(pointsSize);
+    for (int i = 0; i < pointsSize; ++i) {
+        pointsF[i].x = float(points[i].x);
+        pointsF[i].y = float(points[i].y);
+    }
+
+    std::vector<BezierApproxCurve3ControlsF> expected(pointsSize - 1);
+    int expectedSize = pointsSize - 1;
+    success &= (bezierApproxF(pointsF.data(), pointsSize, 0.5f, expected.data(), &expectedSize) == BEZIER_APPROX_OK);
+
+    std::vector<BezierApproxCurve3ControlsF> ans(pointsSize - 1);
+    int ansSize = pointsSize - 1;
+    success &= (bezierapprox::fit<float>(pointsF.data(), pointsSize, 0.5f, ans.data(), &ansSize) == BEZIER_APPROX_OK);
+
+    success &= (ansSize == expectedSize);
+    for (int i = 0; success && i < ansSize; ++i) {
+        success &= (ans[i].P0.x == expected[i].P0.x && ans[i].P0.y == expected[i].P0.y);
+        success &= (ans[i].P1.x == expected[i].P1.x && ans[i].P1.y == expected[i].P1.y);
+        success &= (ans[i].P2.x == expected[i].P2.x && ans[i].P2.y == expected[i].P2.y);
+        success &= (ans[i].P3.x == expected[i].P3.x && ans[i].P3.y == expected[i].P3.y);
+    }
+
+    // Single precision splits where the double fit does, within a few curves.
+    std::vector<BezierApproxCurve3Controls> doubleControls(pointsSize - 1);
+    int doubleSize = pointsSize - 1;
+    success &= (bezierApprox(points.data(), pointsSize, 0.5, doubleControls.data(), &doubleSize) == BEZIER_APPROX_OK);
+    success &= (std::abs(ansSize - doubleSize) <= 2);
+    return success;
+}
+
+bool runAllTests() {
+    bool success = true;
+    success &= test_evaluate();
+    success &= test_fitOneCurve();
+    success &= test_fitDouble();
+    success &= test_fitFloat();
+    return success;
+}
+
+int main() {
+    bool success = runAllTests();
+    int errorCode = 0;
+    if (success) {
+        std::printf("SUCCESS");
+    }
+    else {
+        std::printf("FAILED");
+        errorCode = 1;
+    }
+    return errorCode;
+}
@@ -0,0 +1,333 @@
+#include <bezierapproxpipeline.h>
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#define WORKERS_COUNT 4
+#define PRODUCERS_COUNT 4
+#define QUEUE_CAPACITY 64
+#define STROKES_PER_PRODUCER 500
+#define STROKE_VARIANTS 16
+#define STROKE_POINTS 200
+
+typedef struct _LoadState {
+    BezierApproxPipeline* pipeline;
+    BezierApproxPoint* strokes[STROKE_VARIANTS];
+    unsigned long long nextSequence[PRODUCERS_COUNT];
+    atomic_int orderErrors;
+    atomic_int fitErrors;
+} LoadState;
+
+typedef struct _ProducerArgs {
+    LoadState* state;
+    int streamId;
+} ProducerArgs;
+
+static inline double getTimeSeconds() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
+
+static void onFitted(
+    void* userData,
+    int streamId,
+    unsigned long long sequence,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize
+) {
+    LoadState* state = (LoadState*)userData;
+    if (sequence != state->nextSequence[streamId]) {
+        atomic_fetch_add(&state->orderErrors, 1);
+    }
+    state->nextSequence[streamId] = sequence + 1;
+    if (result != BEZIER_APPROX_OK || controlsSize < 1 || !controls) {
+        atomic_fetch_add(&state->fitErrors, 1);
+    }
+}
+
+static int producerMain(void* arg) {
+    ProducerArgs* args = (ProducerArgs*)arg;
+    LoadState* state = args->state;
+    for (int i = 0; i < STROKES_PER_PRODUCER; ++i) {
+        const BezierApproxPoint* stroke = state->strokes[(i + args->streamId) % STROKE_VARIANTS];
+        while (bezierApproxPipelineSubmit(
+            state->pipeline,
+            args->streamId,
+            stroke,
+            STROKE_POINTS,
+            0.5
+        ) == BEZIER_APPROX_QUEUE_FULL) {
+            thrd_yield();
+        }
+    }
+    return 0;
+}
+
+bool test_pipelineLoad() {
+    bool success = true;
+    LoadState state = { 0 };
+    thrd_t producers[PRODUCERS_COUNT];
+    ProducerArgs producerArgs[PRODUCERS_COUNT];
+
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        state.strokes[v] = (BezierApproxPoint*)malloc(STROKE_POINTS * sizeof(BezierApproxPoint));
+        if (!state.strokes[v]) {
+            success = false;
+            goto cleanup;
+        }
+        for (int i = 0; i < STROKE_POINTS; ++i) {
+            state.strokes[v][i].x = i;
+            state.strokes[v][i].y = 40.0 * sin(0.03 * i * (v + 1)) + 10.0 * sin(0.2 * i);
+        }
+    }
+
+    int result = bezierApproxPipelineCreate(
+        WORKERS_COUNT,
+        QUEUE_CAPACITY,
+        PRODUCERS_COUNT,
+        onFitted,
+        &state,
+        &state.pipeline
+    );
+    if (result != BEZIER_APPROX_OK) {
+        success = false;
+        goto cleanup;
+    }
+
+    double startTime = getTimeSeconds();
+    for (int p = 0; p < PRODUCERS_COUNT; ++p) {
+        producerArgs[p].state = &state;
+        producerArgs[p].streamId = p;
+        thrd_create(&producers[p], producerMain, &producerArgs[p]);
+    }
+    for (int p = 0; p < PRODUCERS_COUNT; ++p) {
+        thrd_join(producers[p], NULL);
+    }
+    bezierApproxPipelineFlush(state.pipeline);
+    double elapsed = getTimeSeconds() - startTime;
+
+    BezierApproxPipelineStats stats;
+    bezierApproxPipelineGetStats(state.pipeline, &stats);
+
+    const unsigned long long total = PRODUCERS_COUNT * STROKES_PER_PRODUCER;
+    success &= (stats.submitted == total);
+    success &= (stats.completed == total);
+    success &= (stats.queueDepth == 0);
+    success &= (atomic_load(&state.orderErrors) == 0);
+    success &= (atomic_load(&state.fitErrors) == 0);
+    for (int p = 0; p < PRODUCERS_COUNT; ++p) {
+        success &= (state.nextSequence[p] == STROKES_PER_PRODUCER);
+    }
+
+    printf("pipeline: %llu strokes in %.3lf s, %.0lf strokes/s, "
+        "latency mean %.3lf ms, p99 %.3lf ms, max %.3lf ms, rejected %llu\n",
+        stats.completed, elapsed, stats.completed / elapsed,
+        1.0e3 * stats.meanLatency, 1.0e3 * stats.p99Latency, 1.0e3 * stats.maxLatency,
+        stats.rejected
+    );
+
+cleanup:
+    if (state.pipeline) {
+        bezierApproxPipelineDestroy(state.pipeline);
+        state.pipeline = NULL;
+    }
+    for (int v = 0; v < STROKE_VARIANTS; ++v) {
+        if (state.strokes[v]) {
+            free(state.strokes[v]);
+            state.strokes[v] = NULL;
+        }
+    }
+    return success;
+}
+
+typedef struct _StreamState {
+    BezierApproxPipeline* pipeline;
+    const BezierApproxPoint* stroke;
+    unsigned long long nextSequence;
+    unsigned long long chainLength;
+    atomic_int stalled;
+    atomic_int released;
+    atomic_int orderErrors;
+    atomic_int submitErrors;
+} StreamState;
+
+// The first callback blocks until the test releases it, so every later
+// result of its stream stays undelivered meanwhile.
+static void onFittedStalled(
+    void* userData,
+    int streamId,
+    unsigned long long sequence,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize
+) {
+    (void)streamId;
+    (void)controls;
+    (void)controlsSize;
+    StreamState* state = (StreamState*)userData;
+    if (sequence != state->nextSequence || result != BEZIER_APPROX_OK) {
+        atomic_fetch_add(&state->orderErrors, 1);
+    }
+    state->nextSequence = sequence + 1;
+
+    if (sequence == 0) {
+        atomic_store(&state->stalled, 1);
+        const struct timespec pause = { 0, 1000000 };
+        while (!atomic_load(&state->released)) {
+            thrd_sleep(&pause, NULL);
+        }
+    }
+}
+
+bool test_pipelineStall() {
+    bool success = true;
+    StreamState state = { 0 };
+    BezierApproxPoint stroke[STROKE_POINTS];
+    const int workersCount = 2;
+    const int queueCapacity = 8;
+    const struct timespec pause = { 0, 1000000 };
+
+    for (int i = 0; i < STROKE_POINTS; ++i) {
+        stroke[i].x = i;
+        stroke[i].y = 40.0 * sin(0.03 * i);
+    }
+    state.stroke = stroke;
+
+    int result = bezierApproxPipelineCreate(
+        workersCount,
+        queueCapacity,
+        2,
+        onFittedStalled,
+        &state,
+        &state.pipeline
+    );
+    if (result != BEZIER_APPROX_OK) {
+        return false;
+    }
+
+    result = bezierApproxPipelineSubmit(state.pipeline, 0, stroke, STROKE_POINTS, 0.5);
+    success &= (result == BEZIER_APPROX_OK);
+    while (success && !atomic_load(&state.stalled)) {
+        thrd_sleep(&pause, NULL);
+    }
+
+    // Submit keeps working while the callback is stalled, and stops taking
+    // jobs of the stalled stream once its parked results reach the bound,
+    // which doesn't count the result in the callback.
+    int accepted = 1;
+    int rejectedInRow = 0;
+    for (int attempt = 0; attempt < 1000 && rejectedInRow < 100; ++attempt) {
+        result = bezierApproxPipelineSubmit(state.pipeline, 0, stroke, STROKE_POINTS, 0.5);
+        if (result == BEZIER_APPROX_OK) {
+            ++accepted;
+            rejectedInRow = 0;
+            continue;
+        }
+        success &= (result == BEZIER_APPROX_QUEUE_FULL);
+        ++rejectedInRow;
+        thrd_sleep(&pause, NULL);
+    }
+    success &= (rejectedInRow == 100);
+    success &= (accepted > queueCapacity && accepted <= queueCapacity + workersCount + 1);
+
+    BezierApproxPipelineStats stats;
+    bezierApproxPipelineGetStats(state.pipeline, &stats);
+    success &= (stats.queueDepth == 0);
+    success &= (stats.completed == 0);
+
+    atomic_store(&state.released, 1);
+    bezierApproxPipelineFlush(state.pipeline);
+    bezierApproxPipelineGetStats(state.pipeline, &stats);
+    success &= (stats.completed == (unsigned long long)accepted);
+    success &= (state.nextSequence == (unsigned long long)accepted);
+    success &= (atomic_load(&state.orderErrors) == 0);
+
+    bezierApproxPipelineDestroy(state.pipeline);
+    if (!success) {
+        printf("test_pipelineStall failed, accepted %d.\n", accepted);
+    }
+    return success;
+}
+
+// Each callback submits the next polyline into its own stream.
+static void onFittedChained(
+    void* userData,
+    int streamId,
+    unsigned long long sequence,
+    int result,
+    const BezierApproxCurve3Controls* controls,
+    int controlsSize
+) {
+    (void)controls;
+    (void)controlsSize;
+    StreamState* state = (StreamState*)userData;
+    if (sequence != state->nextSequence || result != BEZIER_APPROX_OK) {
+        atomic_fetch_add(&state->orderErrors, 1);
+    }
+    state->nextSequence = sequence + 1;
+    if (sequence + 1 < state->chainLength &&
+        bezierApproxPipelineSubmit(state->pipeline, streamId, state->stroke, STROKE_POINTS, 0.5) !=
+            BEZIER_APPROX_OK) {
+        atomic_fetch_add(&state->submitErrors, 1);
+    }
+}
+
+bool test_pipelineCallbackSubmit() {
+    bool success = true;
+    StreamState state = { 0 };
+    BezierApproxPoint stroke[STROKE_POINTS];
+
+    for (int i = 0; i < STROKE_POINTS; ++i) {
+        stroke[i].x = i;
+        stroke[i].y = 40.0 * sin(0.03 * i);
+    }
+    state.stroke = stroke;
+    state.chainLength = 100;
+
+    int result = bezierApproxPipelineCreate(2, 8, 1, onFittedChained, &state, &state.pipeline);
+    if (result != BEZIER_APPROX_OK) {
+        return false;
+    }
+
+    result = bezierApproxPipelineSubmit(state.pipeline, 0, stroke, STROKE_POINTS, 0.5);
+    success &= (result == BEZIER_APPROX_OK);
+    bezierApproxPipelineFlush(state.pipeline);
+
+    success &= (state.nextSequence == state.chainLength);
+    success &= (atomic_load(&state.orderErrors) == 0);
+    success &= (atomic_load(&state.submitErrors) == 0);
+
+    bezierApproxPipelineDestroy(state.pipeline);
+    if (!success) {
+        printf("test_pipelineCallbackSubmit failed.\n");
+    }
+    return success;
+}
+
+bool runAllTests() {
+    bool success = true;
+    success &= test_pipelineLoad();
+    success &= test_pipelineStall();
+    success &= test_pipelineCallbackSubmit();
+    return success;
+}
+
+int main() {
+    bool success = runAllTests();
+    int errorCode = 0;
+    if (success) {
+        printf("SUCCESS");
+    }
+    else {
+        printf("FAILED");
+        errorCode = 1;
+    }
+    return errorCode;
+}
@@ -1,8 +1,10 @@
 #include <bezierapprox.h>
 
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined(_MSC_VER)
     #define _CRTDBG_MAP_ALLOC
@@ -406,6 +408,892 @@ bool test_randomPoints() {
     return success;
 }
 
+static inline void fillRandomPoints(
+    BezierApproxPoint* points,
+    int first,
+    int last
+) {
+    const int RND_STEP = 10;
+    for (int i = first; i <= last; ++i) {
+        int dx = bezierRandom(1, RND_STEP);
+        int dy = bezierRandom(-RND_STEP, RND_STEP);
+        if (i == 0) {
+            points[i].x = dx;
+            points[i].y = dy;
+        }
+        else {
+            points[i].x = points[i - 1].x + dx;
+            points[i].y = points[i - 1].y + dy;
+        }
+    }
+}
+
+static inline bool checkSplits(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    const BezierApproxCurve3Controls* controlsBuffer,
+    const int* splits,
+    int controlsBufferSize
+) {
+    bool success = true;
+    success &= (splits[0] == 0);
+    success &= (splits[controlsBufferSize] == pointsSize - 1);
+    for (int i = 0; i < controlsBufferSize && success; ++i) {
+        success &= (splits[i] < splits[i + 1]);
+        BezierApproxPoint first = bezierApproxGetCurveValue(controlsBuffer[i], 0.0);
+        BezierApproxPoint last = bezierApproxGetCurveValue(controlsBuffer[i], 1.0);
+        success &= epsNear(first.x, points[splits[i]].x) && epsNear(first.y, points[splits[i]].y);
+        success &= epsNear(last.x, points[splits[i + 1]].x) && epsNear(last.y, points[splits[i + 1]].y);
+    }
+    return success;
+}
+
+// Distance of the points to the curve at their chord length parameters,
+// which is the error the library keeps within precision.
+static inline double getSegmentMaxDistance(
+    const BezierApproxPoint* points,
+    int first,
+    int last,
+    const BezierApproxCurve3Controls* controls
+) {
+    double length = 0.0;
+    for (int i = first + 1; i <= last; ++i) {
+        length += hypot(points[i].x - points[i - 1].x, points[i].y - points[i - 1].y);
+    }
+    double maxDist = 0.0;
+    double dist = 0.0;
+    for (int i = first; i <= last; ++i) {
+        if (i > first) {
+            dist += hypot(points[i].x - points[i - 1].x, points[i].y - points[i - 1].y);
+        }
+        BezierApproxPoint value = bezierApproxGetCurveValue(*controls, length > 0.0 ? dist / length : 0.0);
+        maxDist = fmax(maxDist, hypot(value.x - points[i].x, value.y - points[i].y));
+    }
+    return maxDist;
+}
+
+bool runRefitTest(
+    int pointsSize,
+    int editFirstIndex,
+    int editRemovedCount,
+    int editInsertedCount
+) {
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxPoint* editedPoints = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    BezierApproxCurve3Controls* prevControls = NULL;
+    int* splits = NULL;
+    int* prevSplits = NULL;
+    const int editedPointsSize = pointsSize - editRemovedCount + editInsertedCount;
+    const int capacity = (pointsSize > editedPointsSize ? pointsSize : editedPointsSize);
+    int controlsBufferSize = capacity - 1;
+    const double precision = 1.0;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    editedPoints = (BezierApproxPoint*)malloc(editedPointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    prevControls = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    splits = (int*)malloc(capacity * sizeof(int));
+    prevSplits = (int*)malloc(capacity * sizeof(int));
+    if (!points || !editedPoints || !controlsBuffer || !prevControls || !splits || !prevSplits) {
+        success = false;
+        goto cleanup;
+    }
+
+    fillRandomPoints(points, 0, pointsSize - 1);
+    int result = bezierApproxWithSplits(
+        points,
+        pointsSize,
+        precision,
+        controlsBuffer,
+        &controlsBufferSize,
+        splits
+    );
+    success &= (result == BEZIER_APPROX_OK);
+    success &= checkSplits(points, pointsSize, controlsBuffer, splits, controlsBufferSize);
+    if (!success) {
+        goto cleanup;
+    }
+
+    for (int i = 0; i < editFirstIndex; ++i) {
+        editedPoints[i] = points[i];
+    }
+    fillRandomPoints(editedPoints, editFirstIndex, editFirstIndex + editInsertedCount - 1);
+    for (int i = editFirstIndex + editRemovedCount; i < pointsSize; ++i) {
+        editedPoints[i - editRemovedCount + editInsertedCount] = points[i];
+    }
+
+    const int prevControlsSize = controlsBufferSize;
+    memcpy(prevControls, controlsBuffer, prevControlsSize * sizeof(BezierApproxCurve3Controls));
+    memcpy(prevSplits, splits, (prevControlsSize + 1) * sizeof(int));
+    controlsBufferSize = capacity - 1;
+    result = bezierApproxRefit(
+        editedPoints,
+        editedPointsSize,
+        precision,
+        controlsBuffer,
+        splits,
+        prevControlsSize,
+        editFirstIndex,
+        editRemovedCount,
+        editInsertedCount,
+        controlsBuffer,
+        &controlsBufferSize,
+        splits
+    );
+    success &= (result == BEZIER_APPROX_OK);
+    success &= checkSplits(editedPoints, editedPointsSize, controlsBuffer, splits, controlsBufferSize);
+    for (int i = 0; i < controlsBufferSize && success; ++i) {
+        double maxDist = getSegmentMaxDistance(editedPoints, splits[i], splits[i + 1], &controlsBuffer[i]);
+        success &= (maxDist <= precision + EPS || splits[i + 1] - splits[i] < 2);
+    }
+
+    // Curves followed or preceded by another curve that doesn't touch the
+    // edit or its tangent neighbours are copied as they were.
+    const int delta = editInsertedCount - editRemovedCount;
+    for (int i = 0; i + 2 <= prevControlsSize && success; ++i) {
+        if (prevSplits[i + 2] <= editFirstIndex - 2) {
+            success &= (memcmp(&controlsBuffer[i], &prevControls[i], sizeof(BezierApproxCurve3Controls)) == 0);
+            success &= (splits[i] == prevSplits[i]);
+        }
+    }
+    for (int i = 1; i < prevControlsSize && success; ++i) {
+        if (prevSplits[i - 1] >= editFirstIndex + editRemovedCount + 1) {
+            const int j = i - prevControlsSize + controlsBufferSize;
+            success &= (memcmp(&controlsBuffer[j], &prevControls[i], sizeof(BezierApproxCurve3Controls)) == 0);
+            success &= (splits[j] == prevSplits[i] + delta);
+        }
+    }
+    if (!success) {
+        printf("runRefitTest failed. Size: %d, edit: %d %d %d.\n",
+            pointsSize, editFirstIndex, editRemovedCount, editInsertedCount);
+    }
+
+cleanup:
+    if (prevSplits) {
+        free(prevSplits);
+        prevSplits = NULL;
+    }
+    if (splits) {
+        free(splits);
+        splits = NULL;
+    }
+    if (prevControls) {
+        free(prevControls);
+        prevControls = NULL;
+    }
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (editedPoints) {
+        free(editedPoints);
+        editedPoints = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_refit() {
+    srand(2024);
+    bool success = true;
+    success &= runRefitTest(200, 100, 5, 5);
+    success &= runRefitTest(200, 100, 0, 7);
+    success &= runRefitTest(200, 100, 9, 0);
+    success &= runRefitTest(200, 0, 3, 3);
+    success &= runRefitTest(200, 197, 3, 2);
+    success &= runRefitTest(3, 1, 1, 1);
+    return success;
+}
+
+static int isCancelled(void* userData) {
+    return *(const int*)userData;
+}
+
+bool test_budget() {
+    srand(4242);
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    const int pointsSize = 500;
+    const double precision = 1.0;
+    int controlsBufferSize = pointsSize - 1;
+    double maxError = -1.0;
+    int cancelled = 1;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    if (!points || !controlsBuffer) {
+        success = false;
+        goto cleanup;
+    }
+    fillRandomPoints(points, 0, pointsSize - 1);
+
+    int result = bezierApproxWithBudget(
+        points,
+        pointsSize,
+        precision,
+        0.0,
+        isCancelled,
+        &cancelled,
+        controlsBuffer,
+        &controlsBufferSize,
+        &maxError
+    );
+    success &= (result == BEZIER_APPROX_INTERRUPTED);
+    success &= (controlsBufferSize == 1);
+    success &= (maxError > precision);
+    success &= epsNear(maxError, getSegmentMaxDistance(points, 0, pointsSize - 1, &controlsBuffer[0]));
+    BezierApproxPoint tLastVal = bezierApproxGetCurveValue(controlsBuffer[0], 1.0);
+    success &= epsNear(points[pointsSize - 1].x, tLastVal.x) && epsNear(points[pointsSize - 1].y, tLastVal.y);
+
+    cancelled = 0;
+    controlsBufferSize = pointsSize - 1;
+    result = bezierApproxWithBudget(
+        points,
+        pointsSize,
+        precision,
+        10.0,
+        isCancelled,
+        &cancelled,
+        controlsBuffer,
+        &controlsBufferSize,
+        &maxError
+    );
+    success &= (result == BEZIER_APPROX_OK);
+    success &= (controlsBufferSize > 1);
+    success &= (maxError <= precision);
+    if (!success) {
+        printf("test_budget failed.\n");
+    }
+
+cleanup:
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+static inline void fillWavePoints(
+    BezierApproxPoint* points,
+    int pointsSize,
+    double phase
+) {
+    for (int i = 0; i < pointsSize; ++i) {
+        points[i].x = i;
+        points[i].y = 50.0 * sin(0.05 * i + phase) + 20.0 * sin(0.13 * i);
+    }
+}
+
+static inline bool checkContinuity(
+    const BezierApproxPoint* points,
+    int pointsSize,
+    const BezierApproxCurve3Controls* controlsBuffer,
+    int controlsBufferSize
+) {
+    bool success = true;
+    success &= epsNear(controlsBuffer[0].P0.x, points[0].x) && epsNear(controlsBuffer[0].P0.y, points[0].y);
+    for (int i = 1; i < controlsBufferSize; ++i) {
+        success &= epsNear(controlsBuffer[i - 1].P3.x, controlsBuffer[i].P0.x);
+        success &= epsNear(controlsBuffer[i - 1].P3.y, controlsBuffer[i].P0.y);
+    }
+    const BezierApproxCurve3Controls* last = &controlsBuffer[controlsBufferSize - 1];
+    success &= epsNear(last->P3.x, points[pointsSize - 1].x) && epsNear(last->P3.y, points[pointsSize - 1].y);
+    return success;
+}
+
+bool test_warmStart() {
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    double* fractions = NULL;
+    double* nextFractions = NULL;
+    const int pointsSize = 1000;
+    const double precision = 0.5;
+    int controlsBufferSize = pointsSize - 1;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    fractions = (double*)malloc(pointsSize * sizeof(double));
+    nextFractions = (double*)malloc(pointsSize * sizeof(double));
+    if (!points || !controlsBuffer || !fractions || !nextFractions) {
+        success = false;
+        goto cleanup;
+    }
+
+    int fractionsSize = 0;
+    for (int frame = 0; frame < 5 && success; ++frame) {
+        fillWavePoints(points, pointsSize, 0.01 * frame);
+        controlsBufferSize = pointsSize - 1;
+#if BEZIERAPPROXLIB_FIT_STATS
+        BezierApproxFitStats startStats;
+        BezierApproxFitStats coldStats;
+        BezierApproxFitStats warmStats;
+        bezierApproxGetFitStats(&startStats);
+#endif
+        int result = bezierApprox(points, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+        success &= (result == BEZIER_APPROX_OK);
+#if BEZIERAPPROXLIB_FIT_STATS
+        bezierApproxGetFitStats(&coldStats);
+#endif
+
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxWarmStart(
+            points,
+            pointsSize,
+            precision,
+            fractions,
+            fractionsSize,
+            controlsBuffer,
+            &controlsBufferSize,
+            nextFractions
+        );
+        success &= (result == BEZIER_APPROX_OK);
+#if BEZIERAPPROXLIB_FIT_STATS
+        bezierApproxGetFitStats(&warmStats);
+        // Seeded fits skip the long curves near the root of the subdivision.
+        success &= (frame == 0 || warmStats.fittedPointsCount - coldStats.fittedPointsCount <
+            coldStats.fittedPointsCount - startStats.fittedPointsCount);
+#endif
+        success &= checkContinuity(points, pointsSize, controlsBuffer, controlsBufferSize);
+        for (int i = 1; i < controlsBufferSize - 1; ++i) {
+            success &= (nextFractions[i - 1] < nextFractions[i]);
+        }
+        // The wave has x equal to the point index, so the curve ends give
+        // the split indices back.
+        for (int i = 0; i < controlsBufferSize; ++i) {
+            const int first = (int)controlsBuffer[i].P0.x;
+            const int last = (int)controlsBuffer[i].P3.x;
+            success &= (getSegmentMaxDistance(points, first, last, &controlsBuffer[i]) <= precision + EPS);
+        }
+
+        double* swap = fractions;
+        fractions = nextFractions;
+        nextFractions = swap;
+        fractionsSize = controlsBufferSize - 1;
+    }
+    if (!success) {
+        printf("test_warmStart failed.\n");
+    }
+
+cleanup:
+    if (nextFractions) {
+        free(nextFractions);
+        nextFractions = NULL;
+    }
+    if (fractions) {
+        free(fractions);
+        fractions = NULL;
+    }
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_sanitized() {
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxPoint* dirtyPoints = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    BezierApproxCurve3Controls* dirtyControlsBuffer = NULL;
+    int* keptIndices = NULL;
+    const int pointsSize = 300;
+    const int dirtyPointsSize = 2 * pointsSize + 1;
+    const double precision = 0.5;
+    int controlsBufferSize = pointsSize - 1;
+    int dirtyControlsBufferSize = pointsSize - 1;
+    int keptIndicesSize = 0;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    dirtyPoints = (BezierApproxPoint*)malloc(dirtyPointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    dirtyControlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(dirtyControlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    keptIndices = (int*)malloc(dirtyPointsSize * sizeof(int));
+    if (!points || !dirtyPoints || !controlsBuffer || !dirtyControlsBuffer || !keptIndices) {
+        success = false;
+        goto cleanup;
+    }
+
+    fillWavePoints(points, pointsSize, 0.0);
+    dirtyPoints[0].x = NAN;
+    dirtyPoints[0].y = 0.0;
+    for (int i = 0; i < pointsSize; ++i) {
+        dirtyPoints[2 * i + 1] = points[i];
+        dirtyPoints[2 * i + 2] = points[i];
+    }
+
+    int result = bezierApprox(
+        dirtyPoints + 1,
+        dirtyPointsSize - 1,
+        precision,
+        dirtyControlsBuffer,
+        &dirtyControlsBufferSize
+    );
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+
+    result = bezierApprox(
+        points,
+        pointsSize,
+        precision,
+        controlsBuffer,
+        &controlsBufferSize
+    );
+    success &= (result == BEZIER_APPROX_OK);
+
+    dirtyControlsBufferSize = pointsSize - 1;
+    result = bezierApproxSanitized(
+        dirtyPoints,
+        dirtyPointsSize,
+        precision,
+        dirtyControlsBuffer,
+        &dirtyControlsBufferSize,
+        keptIndices,
+        &keptIndicesSize
+    );
+    success &= (result == BEZIER_APPROX_OK);
+    success &= (keptIndicesSize == pointsSize);
+    for (int i = 0; i < keptIndicesSize && success; ++i) {
+        success &= (keptIndices[i] == 2 * i + 1);
+    }
+    success &= (dirtyControlsBufferSize == controlsBufferSize);
+    for (int i = 0; i < controlsBufferSize && success; ++i) {
+        success &= epsNear(controlsBuffer[i].P1.x, dirtyControlsBuffer[i].P1.x);
+        success &= epsNear(controlsBuffer[i].P2.y, dirtyControlsBuffer[i].P2.y);
+    }
+
+    result = bezierApproxSanitized(
+        dirtyPoints,
+        dirtyPointsSize,
+        precision,
+        dirtyControlsBuffer,
+        &dirtyControlsBufferSize,
+        NULL,
+        &keptIndicesSize
+    );
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    result = bezierApproxSanitized(
+        dirtyPoints,
+        dirtyPointsSize,
+        precision,
+        dirtyControlsBuffer,
+        &dirtyControlsBufferSize,
+        keptIndices,
+        NULL
+    );
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    if (!success) {
+        printf("test_sanitized failed.\n");
+    }
+
+cleanup:
+    if (keptIndices) {
+        free(keptIndices);
+        keptIndices = NULL;
+    }
+    if (dirtyControlsBuffer) {
+        free(dirtyControlsBuffer);
+        dirtyControlsBuffer = NULL;
+    }
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (dirtyPoints) {
+        free(dirtyPoints);
+        dirtyPoints = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_byCurvesCount() {
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    const int pointsSize = 500;
+    int controlsBufferSize = pointsSize - 1;
+    double firstMaxError = -1.0;
+    double lastMaxError = -1.0;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    if (!points || !controlsBuffer) {
+        success = false;
+        goto cleanup;
+    }
+    fillWavePoints(points, pointsSize, 0.0);
+
+    for (int maxCurvesCount = 1; maxCurvesCount <= 16 && success; maxCurvesCount *= 2) {
+        double maxError = -1.0;
+        controlsBufferSize = pointsSize - 1;
+        int result = bezierApproxByCurvesCount(
+            points,
+            pointsSize,
+            maxCurvesCount,
+            0.0,
+            controlsBuffer,
+            &controlsBufferSize,
+            &maxError
+        );
+        success &= (result == BEZIER_APPROX_OK);
+        success &= (controlsBufferSize == maxCurvesCount);
+        success &= checkContinuity(points, pointsSize, controlsBuffer, controlsBufferSize);
+        if (firstMaxError < 0.0) {
+            firstMaxError = maxError;
+        }
+        lastMaxError = maxError;
+    }
+    success &= (lastMaxError < firstMaxError);
+
+    {
+        double maxError = -1.0;
+        controlsBufferSize = pointsSize - 1;
+        int result = bezierApproxByCurvesCount(
+            points,
+            pointsSize,
+            pointsSize,
+            0.5,
+            controlsBuffer,
+            &controlsBufferSize,
+            &maxError
+        );
+        success &= (result == BEZIER_APPROX_OK);
+        success &= (maxError <= 0.5);
+        success &= checkContinuity(points, pointsSize, controlsBuffer, controlsBufferSize);
+    }
+    if (!success) {
+        printf("test_byCurvesCount failed.\n");
+    }
+
+cleanup:
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_singlePrecision() {
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxPointF* pointsF = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    BezierApproxCurve3ControlsF* controlsBufferF = NULL;
+    const int pointsSize = 500;
+    const double precision = 0.5;
+    int controlsBufferSize = pointsSize - 1;
+    int controlsBufferSizeF = pointsSize - 1;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    pointsF = (BezierApproxPointF*)malloc(pointsSize * sizeof(BezierApproxPointF));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    controlsBufferF = (BezierApproxCurve3ControlsF*)
+        malloc(controlsBufferSizeF * sizeof(BezierApproxCurve3ControlsF));
+    if (!points || !pointsF || !controlsBuffer || !controlsBufferF) {
+        success = false;
+        goto cleanup;
+    }
+
+    fillWavePoints(points, pointsSize, 0.0);
+    for (int i = 0; i < pointsSize; ++i) {
+        pointsF[i].x = (float)points[i].x;
+        pointsF[i].y = (float)points[i].y;
+    }
+
+    {
+        BezierApproxCurve3ControlsF controlsF = {
+            { (float)P0.x, (float)P0.y },
+            { (float)P1.x, (float)P1.y },
+            { (float)P2.x, (float)P2.y },
+            { (float)P3.x, (float)P3.y }
+        };
+        BezierApproxCurve3Controls controls = { P0, P1, P2, P3 };
+        for (int i = 0; i < N; ++i) {
+            BezierApproxPointF ans = bezierApproxGetCurveValueF(controlsF, (float)t[i]);
+            BezierApproxPoint expected = bezierApproxGetCurveValue(controls, t[i]);
+            success &= epsNear(ans.x, expected.x) && epsNear(ans.y, expected.y);
+        }
+    }
+
+    int result = bezierApprox(points, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+
+    result = bezierApproxF(pointsF, pointsSize, (float)precision, controlsBufferF, &controlsBufferSizeF);
+    success &= (result == BEZIER_APPROX_OK);
+    success &= (abs(controlsBufferSizeF - controlsBufferSize) <= controlsBufferSize / 10);
+    success &= epsNear(controlsBufferF[0].P0.x, points[0].x) && epsNear(controlsBufferF[0].P0.y, points[0].y);
+    for (int i = 1; i < controlsBufferSizeF; ++i) {
+        success &= epsNear(controlsBufferF[i - 1].P3.x, controlsBufferF[i].P0.x);
+        success &= epsNear(controlsBufferF[i - 1].P3.y, controlsBufferF[i].P0.y);
+    }
+    if (!success) {
+        printf("test_singlePrecision failed. Curves: %d, single precision curves: %d.\n",
+            controlsBufferSize, controlsBufferSizeF);
+    }
+
+cleanup:
+    if (controlsBufferF) {
+        free(controlsBufferF);
+        controlsBufferF = NULL;
+    }
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (pointsF) {
+        free(pointsF);
+        pointsF = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_tangentEstimators() {
+    srand(777);
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    const int pointsSize = 2000;
+    const double precision = 1.0;
+    int controlsBufferSize = pointsSize - 1;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    if (!points || !controlsBuffer) {
+        success = false;
+        goto cleanup;
+    }
+    for (int i = 0; i < pointsSize; ++i) {
+        points[i].x = 0.5 * i;
+        points[i].y = 50.0 * sin(0.002 * i) + 20.0 * sin(0.013 * i) + 0.4 * rand() / RAND_MAX - 0.2;
+    }
+
+    int result = bezierApprox(points, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    const int centralSize = controlsBufferSize;
+
+    const int estimators[] = {
+        BEZIER_APPROX_TANGENT_LEAST_SQUARES,
+        BEZIER_APPROX_TANGENT_ARC_WEIGHTED
+    };
+    for (int e = 0; e < 2; ++e) {
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxWithTangents(
+            points,
+            pointsSize,
+            precision,
+            estimators[e],
+            4,
+            controlsBuffer,
+            &controlsBufferSize
+        );
+        success &= (result == BEZIER_APPROX_OK);
+        success &= (controlsBufferSize < centralSize);
+        success &= checkContinuity(points, pointsSize, controlsBuffer, controlsBufferSize);
+
+        // A window wider than the points is the same as one over all of them.
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxWithTangents(points, pointsSize, precision, estimators[e], pointsSize - 1,
+            controlsBuffer, &controlsBufferSize);
+        success &= (result == BEZIER_APPROX_OK);
+        const int wholeSize = controlsBufferSize;
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxWithTangents(points, pointsSize, precision, estimators[e], INT_MAX,
+            controlsBuffer, &controlsBufferSize);
+        success &= (result == BEZIER_APPROX_OK);
+        success &= (controlsBufferSize == wholeSize);
+    }
+
+    controlsBufferSize = pointsSize - 1;
+    result = bezierApproxWithTangents(points, pointsSize, precision, 42, 4, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    result = bezierApproxWithTangents(points, pointsSize, precision,
+        BEZIER_APPROX_TANGENT_LEAST_SQUARES, 0, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    if (!success) {
+        printf("test_tangentEstimators failed.\n");
+    }
+
+cleanup:
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_orthogonal() {
+    srand(778);
+    bool success = true;
+    BezierApproxPoint* points = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    const int pointsSize = 2000;
+    const double precision = 1.0;
+    int controlsBufferSize = pointsSize - 1;
+
+    points = (BezierApproxPoint*)malloc(pointsSize * sizeof(BezierApproxPoint));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    if (!points || !controlsBuffer) {
+        success = false;
+        goto cleanup;
+    }
+    for (int i = 0; i < pointsSize; ++i) {
+        points[i].x = 0.5 * i;
+        points[i].y = 50.0 * sin(0.002 * i) + 20.0 * sin(0.013 * i) + 0.4 * rand() / RAND_MAX - 0.2;
+    }
+
+    int result = bezierApprox(points, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    const int chordSize = controlsBufferSize;
+
+    for (int refineIterations = 0; refineIterations <= 3; ++refineIterations) {
+        controlsBufferSize = pointsSize - 1;
+        result = bezierApproxOrthogonal(
+            points,
+            pointsSize,
+            precision,
+            refineIterations,
+            controlsBuffer,
+            &controlsBufferSize
+        );
+        success &= (result == BEZIER_APPROX_OK);
+        success &= (controlsBufferSize <= chordSize);
+        success &= checkContinuity(points, pointsSize, controlsBuffer, controlsBufferSize);
+    }
+
+    controlsBufferSize = pointsSize - 1;
+    result = bezierApproxOrthogonal(points, pointsSize, precision, -1, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    if (!success) {
+        printf("test_orthogonal failed.\n");
+    }
+
+cleanup:
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (points) {
+        free(points);
+        points = NULL;
+    }
+    return success;
+}
+
+bool test_timeSeries() {
+    srand(779);
+    bool success = true;
+    double* timestamps = NULL;
+    double* values = NULL;
+    BezierApproxCurve3Controls* controlsBuffer = NULL;
+    const int pointsSize = 2000;
+    const double precision = 0.5;
+    int controlsBufferSize = pointsSize - 1;
+
+    timestamps = (double*)malloc(pointsSize * sizeof(double));
+    values = (double*)malloc(pointsSize * sizeof(double));
+    controlsBuffer = (BezierApproxCurve3Controls*)
+        malloc(controlsBufferSize * sizeof(BezierApproxCurve3Controls));
+    if (!timestamps || !values || !controlsBuffer) {
+        success = false;
+        goto cleanup;
+    }
+    for (int i = 0; i < pointsSize; ++i) {
+        timestamps[i] = (i > 0 ? timestamps[i - 1] : 0.0) + 0.5 + 1.0 * rand() / RAND_MAX;
+        values[i] = 50.0 * sin(0.002 * i) + 20.0 * sin(0.013 * i) + 0.4 * rand() / RAND_MAX - 0.2;
+    }
+
+    int result = bezierApproxTimeSeries(timestamps, values, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_OK);
+    success &= (controlsBufferSize > 1);
+
+    // Every sample must be within precision of the curve covering its
+    // timestamp, at the parameter proportional to the timestamp.
+    int curveIdx = 0;
+    for (int i = 0; i < pointsSize && success; ++i) {
+        while (curveIdx < controlsBufferSize - 1 && controlsBuffer[curveIdx].P3.x < timestamps[i]) {
+            ++curveIdx;
+        }
+        const BezierApproxCurve3Controls* controls = &controlsBuffer[curveIdx];
+        double t = (timestamps[i] - controls->P0.x) / (controls->P3.x - controls->P0.x);
+        BezierApproxPoint value = bezierApproxGetCurveValue(*controls, t);
+        success &= epsNear(value.x, timestamps[i]);
+        success &= (fabs(value.y - values[i]) <= precision + 1.0e-9);
+    }
+    for (int i = 1; i < controlsBufferSize; ++i) {
+        success &= epsNear(controlsBuffer[i - 1].P3.x, controlsBuffer[i].P0.x);
+        success &= epsNear(controlsBuffer[i - 1].P3.y, controlsBuffer[i].P0.y);
+    }
+
+    const int requiredSize = controlsBufferSize;
+    controlsBufferSize = 1;
+    result = bezierApproxTimeSeries(timestamps, values, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_BUFFER_TOO_SMALL);
+    success &= (controlsBufferSize == requiredSize);
+
+    timestamps[pointsSize / 2] = timestamps[pointsSize / 2 - 1];
+    controlsBufferSize = pointsSize - 1;
+    result = bezierApproxTimeSeries(timestamps, values, pointsSize, precision, controlsBuffer, &controlsBufferSize);
+    success &= (result == BEZIER_APPROX_ARGUMENTS_ERROR);
+    if (!success) {
+        printf("test_timeSeries failed.\n");
+    }
+
+cleanup:
+    if (controlsBuffer) {
+        free(controlsBuffer);
+        controlsBuffer = NULL;
+    }
+    if (values) {
+        free(values);
+        values = NULL;
+    }
+    if (timestamps) {
+        free(timestamps);
+        timestamps = NULL;
+    }
+    return success;
+}
+
 bool runAllTests() {
     bool success = true;
     success &= test_bezierApproxGetCurveValue();
@@ -414,6 +1302,15 @@ bool runAllTests() {
     success &= test_twoPoints();
     success &= test_3pointsInLine();
     success &= test_randomPoints();
+    success &= test_refit();
+    success &= test_budget();
+    success &= test_warmStart();
+    success &= test_sanitized();
+    success &= test_byCurvesCount();
+    success &= test_singlePrecision();
+    success &= test_tangentEstimators();
+    success &= test_orthogonal();
+    success &= test_timeSeries();
     return success;
 }
 